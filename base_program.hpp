@@ -348,6 +348,7 @@ public:
     this->create_gauge_conf();
 
     this->create_directories();
+    this->set_potential_filenames();
 
     this->open_output_data();
   }
@@ -380,6 +381,24 @@ public:
         return; // simply ignore configuration
       }
     }
+    this->do_omeas_U(i);
+    return;
+  }
+
+  /**
+   * @brief measurements over the configuration currently in U
+   *
+   * @param i configuration index
+   * @param gradient_flow false if the gradient flow has been measured already
+   */
+  void do_omeas_U(const size_t &i, const bool &gradient_flow = true) {
+    // one-link integrals of the temporal links, from the unsmeared configuration
+    std::vector<typename accum_type<Group>::type> Ubar;
+    if (omeas.link_integral && (omeas.Wloop || omeas.Ploop || omeas.potentialplanar ||
+                                omeas.potentialnonplanar)) {
+      Ubar = flat_spacetime::temporal_link_integrals(U, pparams.xi, pparams.anisotropic);
+    }
+    const auto *pUbar = omeas.link_integral ? &Ubar : nullptr;
 
     if (omeas.potentialplanar || omeas.potentialnonplanar) {
       gaugeconfig<Group> U1 = U;
@@ -390,12 +409,12 @@ public:
       if (omeas.potentialplanar) {
         omeasurements::meas_loops_planar_pot(U1, pparams, omeas.sizeWloops,
                                              (*this).filename_coarse,
-                                             (*this).filename_fine, i);
+                                             (*this).filename_fine, i, pUbar);
       }
 
       if (omeas.potentialnonplanar) {
         omeasurements::meas_loops_nonplanar_pot(U1, pparams, omeas.sizeWloops,
-                                                (*this).filename_nonplanar, i);
+                                                (*this).filename_nonplanar, i, pUbar);
       }
     }
 
@@ -403,15 +422,35 @@ public:
       if ((*this).omeas.verbosity > 0) {
         std::cout << "## online measuring: Wilson loop\n";
       }
-      omeasurements::meas_wilson_loop<Group>(U, i, omeas.res_dir);
+      omeasurements::meas_wilson_loop<Group>(U, i, omeas.res_dir, pUbar);
     }
-    if ((*this).omeas.gradient_flow.measure_it) {
+    if ((*this).omeas.Ploop) {
+      if ((*this).omeas.verbosity > 0) {
+        std::cout << "## online measuring: Polyakov loop\n";
+      }
+      omeasurements::meas_polyakov_loop<Group>(U, i, omeas.res_dir, pUbar);
+    }
+    if ((*this).omeas.gradient_flow.measure_it && gradient_flow) {
       if ((*this).omeas.verbosity > 0) {
         std::cout << "## online measuring: Gradient flow\n";
       }
       omeasurements::meas_gradient_flow<Group>(U, i, pparams, (*this).omeas);
     }
 
+    if ((*this).omeas.cooling.measure_it) {
+      if ((*this).omeas.verbosity > 0) {
+        std::cout << "## online measuring: Cooling\n";
+      }
+      omeasurements::meas_cooling<Group>(U, i, pparams, (*this).omeas);
+    }
+
+    if ((*this).omeas.multilevel.measure_it) {
+      if ((*this).omeas.verbosity > 0) {
+        std::cout << "## online measuring: Multilevel\n";
+      }
+      omeasurements::meas_multilevel<Group>(U, i, pparams, (*this).omeas);
+    }
+
     if ((*this).omeas.pion_staggered) {
       if ((*this).omeas.verbosity > 0) {
         std::cout << "## online measuring: Pion correlator\n";
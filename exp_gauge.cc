@@ -2,19 +2,59 @@
 #include"su2.hh"
 #include"u1.hh"
 #include"adjointfield.hh"
-#include<vector>
+#include<algorithm>
+#include<cmath>
 #include<complex>
 
+// below this value of alpha^2 sin(alpha)/alpha is computed from its Taylor series,
+// the truncation error alpha^6/5040 is then far below double precision
+static const double exp_taylor_alpha2 = 1.e-8;
+
+// sin(alpha)/alpha for alpha^2 = alpha2, with a Taylor branch for small alpha
+static inline double sinc_sqrt(const double alpha2) {
+  if(alpha2 < exp_taylor_alpha2) {
+    return 1. - alpha2/6.*(1. - alpha2/20.);
+  }
+  const double alpha = std::sqrt(alpha2);
+  return std::sin(alpha)/alpha;
+}
+
 _su2 exp(adjointsu2<double> const & x) {
-  double a = x.geta(), b = x.getb(), c = x.getc();
-  // normalise the vector
-  const double alpha = sqrt(a*a+b*b+c*c);
-  std::vector<double> n = {a/alpha, b/alpha, c/alpha};
+  const double a = x.geta(), b = x.getb(), c = x.getc();
+  const double alpha2 = a*a+b*b+c*c;
+  // sin(alpha)*n with the normalised vector n = (a, b, c)/alpha
+  const double s = sinc_sqrt(alpha2);
 
-  const double salpha = sin(alpha);
-  _su2 res(Complex(cos(alpha), salpha*n[2]), 
-           salpha*Complex(n[1], n[0]));
+  _su2 res(Complex(std::cos(std::sqrt(alpha2)), s*c), 
+           Complex(s*b, s*a));
   return res;
 }
 
+void exp_and_multiply(const size_t n, const double dtau,
+                      const adjointsu2<double> * P, _su2 * U, const bool restore) {
+  // the links are processed in blocks: first the arguments are gathered in plain
+  // arrays, such that the loop with the transcendental functions can be vectorized
+  constexpr size_t block = 64;
+  double a[block], b[block], c[block], co[block], s[block];
 
+  for(size_t i0 = 0; i0 < n; i0 += block) {
+    const size_t m = std::min(block, n - i0);
+    for(size_t k = 0; k < m; k++) {
+      a[k] = dtau*P[i0+k].geta();
+      b[k] = dtau*P[i0+k].getb();
+      c[k] = dtau*P[i0+k].getc();
+    }
+#pragma omp simd
+    for(size_t k = 0; k < m; k++) {
+      const double alpha2 = a[k]*a[k]+b[k]*b[k]+c[k]*c[k];
+      const double alpha = std::sqrt(alpha2);
+      co[k] = std::cos(alpha);
+      s[k] = (alpha2 < exp_taylor_alpha2) ? 1. - alpha2/6.*(1. - alpha2/20.)
+                                          : std::sin(alpha)/alpha;
+    }
+    for(size_t k = 0; k < m; k++) {
+      U[i0+k] = _su2(Complex(co[k], s[k]*c[k]), Complex(s[k]*b[k], s[k]*a[k])) * U[i0+k];
+      if(restore) U[i0+k].restoreSU();
+    }
+  }
+}
@@ -10,11 +10,15 @@
  */
 
 #include "md_update.hh"
+#include "kramers_md_update.hh"
+#include "lyapunov.hh"
+#include "md_autotune.hh"
 #include "base_program.hpp"
 
 //#include "rotating-gaugemonomial.hpp"
 
 #include "detDDdag_monomial.hh"
+#include "rhmc_monomial.hh"
 
 template <class Group> class hmc_algo : public base_program<Group, gp::hmc> {
 private:
@@ -22,15 +26,27 @@ private:
 
   std::list<monomial<double, Group> *> monomial_list; // list of monomials in the action
 
-  flat_spacetime::gaugemonomial<double, Group> *gm; // gauge monomial
+  flat_spacetime::gaugemonomial<double, Group> *gm = nullptr; // gauge monomial
   // rotating_spacetime::gauge_monomial<double, Group>
   //   *gm_rot; // gauge monomial with space rotation
   kineticmonomial<double, Group> *km; // kinetic momomial (momenta)
-  staggered::detDDdag_monomial<double, Group> *detDDdag; // staggered fermions monomial
+  staggered::detDDdag_monomial<double, Group> *detDDdag =
+    nullptr; // staggered fermions monomial
+  std::vector<staggered::detratio_monomial<double, Group> *>
+    detratios; // Hasenbusch ratios of staggered determinants
+  staggered::rhmc_monomial<double, Group> *rhmc = nullptr; // rational HMC monomial
+  std::vector<staggered::fermion_monomial<double, Group> *>
+    fermion_monomials; // all the pseudo-fermion monomials above
+  staggered::solver_stats stats_action, stats_force; // solver iterations in the run
 
   // Molecular Dynamics (MD)
   integrator<double, Group> *md_integ; // MD integrator
   md_params mdparams; // MD parameters
+  md_workspace<double, Group> *mdws = nullptr; // buffers reused by all trajectories
+
+  std::ofstream os_lyapunov; // output of the Lyapunov exponent measurements
+
+  flat_spacetime::clover_field<Group> clover; // clover field of the last configuration
 
 public:
   hmc_algo() { (*this).algo_name = "hmc"; }
@@ -39,7 +55,12 @@ public:
     // free(gm_rot);
     free(km);
     free(detDDdag);
+    for (size_t k = 0; k < detratios.size(); k++) {
+      delete detratios[k];
+    }
+    delete rhmc;
     free(md_integ);
+    delete mdws;
   }
 
   void print_program_info() const {
@@ -76,13 +97,169 @@ public:
 
     if ((*this).pparams.include_staggered_fermions) { // including S_F (fermionic) in
                                                       // the action
+      // Hasenbusch splitting: det(m0) = det(m_1) * det(m_2)/det(m_1) * ... *
+      // det(m0)/det(m_K). Without intermediate masses this is just det(m0).
+      const std::vector<double> &masses = (*this).sparams.hasenbusch_masses;
+      const size_t K = masses.size();
+      const double m_heavy = (K > 0) ? masses[0] : (*this).pparams.m0;
+      const double tol_heavy =
+        (K > 0) ? (*this).sparams.hasenbusch_tolerances[0] : (*this).sparams.tolerance_cg;
+
       (*this).detDDdag = new staggered::detDDdag_monomial<double, Group>(
-        0, (*this).pparams.m0, (*this).sparams.solver, (*this).sparams.tolerance_cg,
-        (*this).sparams.seed_pf, (*this).sparams.solver_verbosity);
+        0, m_heavy, (*this).sparams.solver, tol_heavy, (*this).sparams.seed_pf,
+        (*this).sparams.solver_verbosity, (*this).sparams.n_chrono);
       (*this).monomial_list.push_back(detDDdag);
+      (*this).fermion_monomials.push_back(detDDdag);
+
+      for (size_t k = 0; k < K; k++) {
+        const double m_light = (k + 1 < K) ? masses[k + 1] : (*this).pparams.m0;
+        // independent pseudo-fermion stream for each monomial
+        const size_t seed = (*this).sparams.seed_pf + (k + 1) * 982451653;
+        (*this).detratios.push_back(new staggered::detratio_monomial<double, Group>(
+          0, m_light, masses[k], (*this).sparams.solver,
+          (*this).sparams.hasenbusch_tolerances[k + 1], seed,
+          (*this).sparams.solver_verbosity, (*this).sparams.n_chrono));
+        (*this).monomial_list.push_back(detratios.back());
+        (*this).fermion_monomials.push_back(detratios.back());
+      }
+    }
+
+    if ((*this).sparams.rhmc) {
+      // seed and verbosity are independent of the det(D*D^{\dagger}) ones
+      (*this).rhmc = new staggered::rhmc_monomial<double, Group>(
+        0, (*this).pparams.m0, (*this).sparams.rhmc_alpha, (*this).pparams.ndims,
+        (*this).sparams.rhmc_tolerance_ra, (*this).sparams.rhmc_tolerance_cg,
+        (*this).sparams.rhmc_seed_pf, (*this).sparams.rhmc_solver_verbosity);
+      (*this).monomial_list.push_back(rhmc);
+      (*this).fermion_monomials.push_back(rhmc);
     }
   }
 
+  /**
+   * @brief set the solver tolerances of the pseudo-fermion monomials
+   * With scale_tolerance_force the force tolerance is proportional to dtau^2, the
+   * order of the energy violation of the (second order) integrators. Has to be called
+   * again when the step size changes.
+   */
+  void set_solver_tolerances() {
+    const double dtau = mdparams.gettau() / double(mdparams.getnsteps());
+    for (size_t k = 0; k < fermion_monomials.size(); k++) {
+      staggered::fermion_monomial<double, Group> *fm = fermion_monomials[k];
+      const double tol_action = ((*this).sparams.tolerance_action > 0.)
+                                  ? (*this).sparams.tolerance_action
+                                  : fm->TOLERANCE;
+      double tol_force =
+        ((*this).sparams.tolerance_force > 0.) ? (*this).sparams.tolerance_force : tol_action;
+      if ((*this).sparams.scale_tolerance_force) {
+        tol_force *= dtau * dtau;
+      }
+      fm->set_tolerances(tol_action, tol_force);
+      std::cout << "## solver tolerances of monomial " << k << ": action=" << tol_action
+                << " force=" << tol_force << "\n";
+    }
+  }
+
+  /**
+   * @brief print and reset the solver iterations of the last trajectory
+   */
+  void print_solver_iterations() {
+    staggered::solver_stats action, force;
+    for (size_t k = 0; k < fermion_monomials.size(); k++) {
+      staggered::fermion_monomial<double, Group> *fm = fermion_monomials[k];
+      action.iterations += fm->stats_action.iterations;
+      action.solves += fm->stats_action.solves;
+      force.iterations += fm->stats_force.iterations;
+      force.solves += fm->stats_force.solves;
+      fm->stats_action.reset();
+      fm->stats_force.reset();
+    }
+    stats_action.iterations += action.iterations;
+    stats_action.solves += action.solves;
+    stats_force.iterations += force.iterations;
+    stats_force.solves += force.solves;
+    std::cout << "## solver iterations: force=" << force.iterations << " (" << force.solves
+              << " solves) action=" << action.iterations << " (" << action.solves
+              << " solves)\n";
+  }
+
+  // file in conf_dir with the tuned integrator, read again on restart
+  std::string autotune_path() const { return (*this).sparams.conf_dir + "/autotune.txt"; }
+
+  /**
+   * @brief tune the integrator on the current configuration
+   * The chosen setup replaces the one from the input file for the rest of the run, is
+   * recorded in the output and saved to autotune_path() for restarts.
+   *
+   * @param i trajectory index
+   */
+  void autotune_integrator(const size_t &i) {
+    std::cout << "## autotune: tuning the integrator at trajectory " << i << "\n";
+    const md_autotune::tuning_result res = md_autotune::tune<double, Group>(
+      (*this).U, (*this).sparams.seed + i, (*this).sparams.n_tune,
+      (*this).sparams.target_acceptance, (*this).sparams.tune_integrators, mdparams,
+      monomial_list);
+    md_autotune::save_tuning(this->autotune_path(), res, mdparams.gettau());
+    this->use_tuned_integrator(res);
+  }
+
+  /**
+   * @brief replace the integrator from the input file by the tuned one
+   */
+  void use_tuned_integrator(const md_autotune::tuning_result &res) {
+    delete md_integ;
+    md_integ = md_autotune::make_integrator<double, Group>(res.integrator, res.lambda);
+    mdparams.setnsteps(res.n_steps);
+    this->set_solver_tolerances(); // the step size has changed
+    for (size_t k = 0; k < fermion_monomials.size(); k++) { // not part of the chain
+      fermion_monomials[k]->stats_action.reset();
+      fermion_monomials[k]->stats_force.reset();
+    }
+
+    std::ostringstream oss;
+    oss << "## autotune: integrator=" << res.integrator;
+    if (res.integrator == "omf2") {
+      oss << " lambda=" << res.lambda;
+    }
+    oss << " n_steps=" << res.n_steps << " tau=" << mdparams.gettau()
+        << " predicted_acceptance=" << res.acceptance << "\n";
+    std::cout << oss.str();
+    (*this).os << oss.str();
+  }
+
+  /**
+   * @brief measure the Lyapunov exponent of the MD evolution on the current
+   * configuration. The distances after each MD step are appended to
+   * lyapunov.u1-hmc.data in conf_dir.
+   *
+   * @param i trajectory index
+   */
+  void measure_lyapunov(const size_t &i) {
+    if (!os_lyapunov.is_open()) {
+      const std::string file = (*this).sparams.conf_dir + "/lyapunov.u1-hmc.data";
+      os_lyapunov.open(file, ((*this).g_icounter == 0) ? std::ios::out : std::ios::app);
+    }
+    os_lyapunov << "## trajectory " << i << " n_copies " << (*this).sparams.lyapunov_copies
+                << " delta " << (*this).sparams.lyapunov_delta << "\n";
+    os_lyapunov << "## step t distance_1 ... distance_K <log(d/d0)>\n";
+
+    // independent of the stream of the chain, which is not touched
+    std::mt19937 engine((*this).sparams.seed + i + 2147483647);
+    const lyapunov::result res = lyapunov::compute_lyapunov(
+      (*this).U, engine, mdparams, monomial_list, *md_integ,
+      (*this).sparams.lyapunov_copies, (*this).sparams.lyapunov_delta,
+      (*this).sparams.lyapunov_steps, os_lyapunov);
+    for (size_t k = 0; k < fermion_monomials.size(); k++) { // not part of the chain
+      fermion_monomials[k]->stats_action.reset();
+      fermion_monomials[k]->stats_force.reset();
+    }
+
+    std::ostringstream oss;
+    oss << "## lyapunov: trajectory " << i << " lambda=" << res.lambda << " +- "
+        << res.error << "\n";
+    std::cout << oss.str();
+    os_lyapunov << oss.str();
+  }
+
   void do_hmc_step(const int &i) {
     if ((*this).sparams.do_mcmc) {
       (*this).mdparams.disablerevtest();
@@ -94,11 +271,19 @@ public:
       std::mt19937 engine((*this).sparams.seed + i);
       // perform the MD update
 
-      md_update((*this).U, engine, mdparams, monomial_list, *md_integ);
+      if ((*this).sparams.kramers) {
+        kramers_md_update((*this).U, engine, mdparams, monomial_list, *md_integ, *mdws);
+      } else {
+        md_update((*this).U, engine, mdparams, monomial_list, *md_integ, *mdws);
+      }
+      if (!fermion_monomials.empty()) {
+        this->print_solver_iterations();
+      }
 
-      const double energy = flat_spacetime::gauge_energy((*this).U);
-      double E = 0., Q = 0.;
-      flat_spacetime::energy_density((*this).U, E, Q);
+      // the plaquettes of U are known from the trajectory
+      const double energy = (gm != nullptr) ? gm->get_plaquettes().retr_sum((*this).U)
+                                            : flat_spacetime::gauge_energy((*this).U);
+      const double Q = clover.observables((*this).U).Q;
       rate += mdparams.getaccept();
 
       std::cout << i << " " << (*this).mdparams.getaccept() << " " << std::scientific
@@ -125,6 +310,10 @@ public:
         (*this).os << "NA";
       }
       (*this).os << " " << Q << std::endl;
+
+      if ((*this).sparams.lyapunov && i % (*this).sparams.lyapunov_nstep == 0) {
+        this->measure_lyapunov(i);
+      }
     }
   }
 
@@ -172,15 +361,41 @@ public:
     // Molecular Dynamics parameters
     md_params md_p0((*this).sparams.n_steps, (*this).sparams.tau);
     mdparams = md_p0;
+    if ((*this).sparams.kramers) {
+      mdparams.setgamma((*this).sparams.kramers_gamma);
+      mdparams.setkmax((*this).sparams.kramers_kmax);
+    }
 
     this->init_monomials();
+    this->set_solver_tolerances();
+    mdws = new md_workspace<double, Group>((*this).U);
 
     // setting up the integrator
     md_integ =
       set_integrator<double, Group>((*this).sparams.integrator, (*this).sparams.exponent);
 
+    // the integrator is tuned once, n_therm_tune trajectories after the start of the
+    // chain; a restarted run reuses the saved choice
+    bool tuned = false;
+    if ((*this).sparams.do_mcmc && (*this).sparams.autotune &&
+        (*this).g_icounter > 0) {
+      md_autotune::tuning_result res;
+      tuned = md_autotune::load_tuning(this->autotune_path(), res, mdparams.gettau());
+      if (tuned) {
+        std::cout << "## autotune: using the integrator tuned in a previous run\n";
+        this->use_tuned_integrator(res);
+      } else if ((*this).g_icounter > (*this).sparams.n_therm_tune) {
+        std::cerr << "## Warning: no tuned integrator in " << this->autotune_path()
+                  << ", keeping the one of the input file" << std::endl;
+      }
+    }
+
     for (size_t i = (*this).g_icounter; i < (*this).sparams.n_meas + (*this).g_icounter;
          i++) {
+      if ((*this).sparams.do_mcmc && (*this).sparams.autotune && !tuned &&
+          i == (*this).sparams.n_therm_tune) {
+        this->autotune_integrator(i);
+      }
       this->do_hmc_step(i);
             // online measurements
       bool do_omeas =
@@ -197,6 +412,14 @@ public:
     if ((*this).sparams.do_mcmc) {
       std::cout << "## Acceptance rate: "
                 << rate / static_cast<double>((*this).sparams.n_meas) << std::endl;
+      if (!fermion_monomials.empty()) {
+        const size_t n_force = std::max(stats_force.solves, size_t(1));
+        const size_t n_action = std::max(stats_action.solves, size_t(1));
+        std::cout << "## Solver iterations per solve: force="
+                  << double(stats_force.iterations) / double(n_force)
+                  << " action=" << double(stats_action.iterations) / double(n_action)
+                  << std::endl;
+      }
       std::string path_final = (*this).conf_path_basename + ".final";
       (*this).U.save(path_final);
     }
@@ -78,6 +78,7 @@ namespace BiCGStab {
         }
       }
 
+      (*this).iterations += num_iter;
       const Float ex_res = (b - A * xk).norm(); // exact residual
 
       if (rk_norm < ex_res) {
@@ -73,6 +73,7 @@ namespace CG {
         }
       }
 
+      (*this).iterations += num_iter;
       const Float ex_res = (b - A * xk).norm(); // exact residual
 
       if (rk_norm < ex_res) {
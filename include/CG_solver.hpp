@@ -72,6 +72,7 @@ namespace CG_solver {
     bool sys_init = false; // true when A and b are initialized
     std::vector<LAvector> curve_x; // trajectory
     bool solved = false; // true when x has been found
+    size_t iterations = 0; // number of iterations, including restarts
 
     void check_solved() const {
       if (!solved) {
@@ -120,6 +121,8 @@ namespace CG_solver {
       return x;
     }
 
+    size_t get_iterations() const { return iterations; }
+
   }; // class LinearCG_solver
 
 } // namespace CG_solver
@@ -1,11 +1,14 @@
 #pragma once
 
+#include "counter_rng.hh"
 #include "geometry.hh"
+#include "parallel_reduction.hh"
 #include "su2.hh"
 #include "u1.hh"
 #include <cassert>
 #include <cmath>
 #include <random>
+#include <utility>
 #include <vector>
 #include <array>
 
@@ -104,7 +107,7 @@ public:
                const size_t Lt,
                const size_t ndims = 4)
     : Lx(Lx), Ly(Ly), Lz(Lz), Lt(Lt), volume(Lx * Ly * Lz * Lt), ndims(ndims) {
-    data.resize(volume * 4);
+    data.resize(volume * ndims);
   }
   adjointfield(const adjointfield &U)
     : Lx(U.getLx()),
@@ -114,15 +117,27 @@ public:
       volume(U.getVolume()),
       ndims(U.getndims()) {
     data.resize(volume * ndims);
+#pragma omp parallel for
     for (size_t i = 0; i < getSize(); i++) {
       data[i] = U[i];
     }
   }
   void flipsign() {
+#pragma omp parallel for
     for (size_t i = 0; i < getSize(); i++) {
       data[i].flipsign();
     }
   }
+  // exchange the content with A, without copying the data
+  void swap(adjointfield<Float, Group> &A) {
+    std::swap(Lx, A.Lx);
+    std::swap(Ly, A.Ly);
+    std::swap(Lz, A.Lz);
+    std::swap(Lt, A.Lt);
+    std::swap(volume, A.volume);
+    std::swap(ndims, A.ndims);
+    data.swap(A.data);
+  }
   size_t storage_size() const { return data.size() * sizeof(value_type); };
   size_t getLx() const { return (Lx); }
   size_t getLy() const { return (Ly); }
@@ -133,11 +148,13 @@ public:
   size_t getSize() const { return (volume * ndims); }
   void operator=(const adjointfield<Float, Group> &U) {
     Lx = U.getLx();
-    Ly = U.getLz();
+    Ly = U.getLy();
     Lz = U.getLz();
     Lt = U.getLt();
     volume = U.getVolume();
+    ndims = U.getndims();
     data.resize(U.getSize());
+#pragma omp parallel for
     for (size_t i = 0; i < U.getSize(); i++) {
       data[i] = U[i];
     }
@@ -208,57 +225,132 @@ inline adjointu1<Float> operator*(const Float &x, const adjointu1<Float> &A) {
 }
 
 template <typename Float, class Group>
-adjointfield<Float, su2> operator*(const Float &x, const adjointfield<Float, Group> &A) {
-  adjointfield<Float, Group> res(A.getLx(), A.getLy(), A.getLz(), A.getLt());
+adjointfield<Float, Group> operator*(const Float &x, const adjointfield<Float, Group> &A) {
+  adjointfield<Float, Group> res(A.getLx(), A.getLy(), A.getLz(), A.getLt(),
+                                 A.getndims());
+#pragma omp parallel for
   for (size_t i = 0; i < A.getSize(); i++) {
     res[i] = x * A[i];
   }
   return res;
 }
 
+// the scalar products use a deterministic parallel sum, such that the kinetic energy
+// (and hence dH) does not depend on the number of threads
 template <typename Float>
 Float operator*(const adjointfield<Float, su2> &A, const adjointfield<Float, su2> &B) {
-  Float res = 0.;
   assert(A.getSize() == B.getSize());
-  for (size_t i = 0; i < A.getSize(); i++) {
-    res +=
-      A[i].geta() * B[i].geta() + A[i].getb() * B[i].getb() + A[i].getc() * B[i].getc();
-  }
-  return res;
+  return parallel_reduction::deterministic_sum<Float>(A.getSize(), [&](const size_t &i) {
+    return A[i].geta() * B[i].geta() + A[i].getb() * B[i].getb() +
+           A[i].getc() * B[i].getc();
+  });
 }
 
 template <typename Float>
 Float operator*(const adjointfield<Float, _u1> &A, const adjointfield<Float, _u1> &B) {
-  Float res = 0.;
   assert(A.getSize() == B.getSize());
-  for (size_t i = 0; i < A.getSize(); i++) {
-    res += A[i].geta() * B[i].geta();
-  }
-  return res;
+  return parallel_reduction::deterministic_sum<Float>(
+    A.getSize(), [&](const size_t &i) { return A[i].geta() * B[i].geta(); });
 }
 
+// number of sites processed per block in the parallel Gaussian generation
+const size_t normal_block_size = 256;
+
+/**
+ * @brief standard normal distributed momenta
+ * A key for counter-based streams is drawn from engine, then the field is filled in
+ * parallel. Element i always gets the same numbers, independent of the number of
+ * threads (see counter_rng.hh).
+ */
 template <class URNG, typename Float>
 void initnormal(URNG &engine, adjointfield<Float, su2> &A) {
-  std::normal_distribution<double> normal(0., 1.);
-  for (size_t i = 0; i < A.getSize(); i++) {
-    A[i].seta(Float(normal(engine)));
-    A[i].setb(Float(normal(engine)));
-    A[i].setc(Float(normal(engine)));
+  const uint64_t key = counter_rng::draw_key(engine);
+  const size_t N = A.getSize();
+#pragma omp parallel for
+  for (size_t i0 = 0; i0 < N; i0 += normal_block_size) {
+    double r[3 * normal_block_size];
+    const size_t m = std::min(normal_block_size, N - i0);
+    counter_rng::fill_normal(key, 3 * i0, 3 * m, r);
+    for (size_t k = 0; k < m; k++) {
+      A[i0 + k].seta(Float(r[3 * k]));
+      A[i0 + k].setb(Float(r[3 * k + 1]));
+      A[i0 + k].setc(Float(r[3 * k + 2]));
+    }
   }
   return;
 }
 
 template <class URNG, typename Float>
 void initnormal(URNG &engine, adjointfield<Float, _u1> &A) {
-  std::normal_distribution<double> normal(0., 1.);
-  for (size_t i = 0; i < A.getSize(); i++) {
-    A[i].seta(Float(normal(engine)));
+  const uint64_t key = counter_rng::draw_key(engine);
+  const size_t N = A.getSize();
+#pragma omp parallel for
+  for (size_t i0 = 0; i0 < N; i0 += normal_block_size) {
+    double r[normal_block_size];
+    const size_t m = std::min(normal_block_size, N - i0);
+    counter_rng::fill_normal(key, i0, m, r);
+    for (size_t k = 0; k < m; k++) {
+      A[i0 + k].seta(Float(r[k]));
+    }
+  }
+  return;
+}
+
+/**
+ * @brief partial momentum refresh P -> c1*P + sqrt(1-c1^2)*eta, with eta standard normal
+ * The Gaussian numbers are generated in the same pass (no field for eta) from a
+ * counter-based stream keyed by engine. The refreshed momenta are written to both A
+ * and A_save, which must have the same size.
+ */
+template <class URNG, typename Float>
+void partial_refresh(URNG &engine,
+                     adjointfield<Float, su2> &A,
+                     adjointfield<Float, su2> &A_save,
+                     const Float &c1) {
+  const uint64_t key = counter_rng::draw_key(engine);
+  const Float c2 = std::sqrt(1.0 - c1 * c1);
+  const size_t N = A.getSize();
+#pragma omp parallel for
+  for (size_t i0 = 0; i0 < N; i0 += normal_block_size) {
+    double r[3 * normal_block_size];
+    const size_t m = std::min(normal_block_size, N - i0);
+    counter_rng::fill_normal(key, 3 * i0, 3 * m, r);
+    for (size_t k = 0; k < m; k++) {
+      adjointsu2<Float> &p = A[i0 + k];
+      p.seta(c1 * p.geta() + c2 * Float(r[3 * k]));
+      p.setb(c1 * p.getb() + c2 * Float(r[3 * k + 1]));
+      p.setc(c1 * p.getc() + c2 * Float(r[3 * k + 2]));
+      A_save[i0 + k] = p;
+    }
+  }
+  return;
+}
+
+template <class URNG, typename Float>
+void partial_refresh(URNG &engine,
+                     adjointfield<Float, _u1> &A,
+                     adjointfield<Float, _u1> &A_save,
+                     const Float &c1) {
+  const uint64_t key = counter_rng::draw_key(engine);
+  const Float c2 = std::sqrt(1.0 - c1 * c1);
+  const size_t N = A.getSize();
+#pragma omp parallel for
+  for (size_t i0 = 0; i0 < N; i0 += normal_block_size) {
+    double r[normal_block_size];
+    const size_t m = std::min(normal_block_size, N - i0);
+    counter_rng::fill_normal(key, i0, m, r);
+    for (size_t k = 0; k < m; k++) {
+      adjointu1<Float> &p = A[i0 + k];
+      p.seta(c1 * p.geta() + c2 * Float(r[k]));
+      A_save[i0 + k] = p;
+    }
   }
   return;
 }
 
 template <typename Float, class Group>
 inline void zeroadjointfield(adjointfield<Float, Group> &A) {
+#pragma omp parallel for
   for (size_t i = 0; i < A.getSize(); i++) {
     A[i].setzero();
   }
@@ -0,0 +1,198 @@
+/**
+ * @file clover_field.hh
+ * @brief cache of the clover field strength G_{mu nu}(x), mu < nu, of a configuration
+ *
+ * G_{mu nu}(x) is the traceless anti-hermitian part of the sum of the four plaquettes
+ * (leaves) in the plane mu-nu touching x (see energy_density() in
+ * flat-energy_density.hh for the normalisation). The energy density E, its
+ * spatial-spatial part E_ss and the topological charge Q are all reductions over this
+ * field, hence the expensive part, the products of links, is done once per
+ * configuration instead of once per observable. The first leaf is the plaquette
+ * P_{mu nu}(x), so the plaquette sums are obtained in the same pass. As for the
+ * plaquettes (see plaquette_field.hh), the field is recomputed only when the revision
+ * stamp of the configuration changes.
+ */
+
+#pragma once
+
+#include "accum_type.hh"
+#include "gaugeconfig.hh"
+#include "geometry.hh"
+#include "parallel_reduction.hh"
+#include "su2.hh"
+#include "tensors.hh"
+#include "u1.hh"
+
+#include <array>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace flat_spacetime {
+
+  /**
+   * @brief observables computed from the clover field
+   */
+  struct clover_observables {
+    double P = 0.; // \sum_x \sum_{mu<nu} Re(Tr(P_{mu nu}(x))), as gauge_energy()
+    double P_ss = 0.; // the same for the spatial-spatial planes only
+    double E = 0.; // energy density
+    double E_ss = 0.; // spatial-spatial part of the energy density
+    double Q = 0.; // topological charge
+
+    clover_observables() {}
+    clover_observables(const int &) {} // zero element of the reduction
+    void operator+=(const clover_observables &o) {
+      P += o.P;
+      P_ss += o.P_ss;
+      E += o.E;
+      E_ss += o.E_ss;
+      Q += o.Q;
+    }
+  };
+
+  template <class Group> class clover_field {
+    typedef typename accum_type<Group>::type accum;
+
+  public:
+    /**
+     * @brief constructor
+     * @param cloverdef if false, G_{mu nu}(x) is built from the plaquette P_{mu nu}(x)
+     * only, instead of the sum over the four leaves
+     */
+    clover_field(const bool &cloverdef = true) : cloverdef(cloverdef) {}
+
+    /**
+     * @brief G_{mu nu}(x) of U, recomputed only if U has changed since the last call
+     * Element (s, p) is stored at s*n_planes + p, where s is the site index and p
+     * labels the plane mu < nu in the order (0,1), (0,2), ..., (1,2), ...
+     */
+    const std::vector<accum> &get(const gaugeconfig<Group> &U) {
+      if (G.size() == 0 || revision != U.getRevision()) {
+        compute(U);
+        revision = U.getRevision();
+      }
+      return G;
+    }
+
+    /**
+     * @brief P, P_ss, E, E_ss and Q in a single parallel pass over the cached field
+     * The sums do not depend on the number of threads. Q is computed for ndims=2, 4
+     * and is 0 otherwise.
+     */
+    clover_observables observables(const gaugeconfig<Group> &U) {
+      const std::vector<accum> &F = (*this).get(U);
+      const size_t d = U.getndims();
+      const size_t np = d * (d - 1) / 2;
+      // Euclidean 4D totally anti-symemtric tensor
+      static const epsilon4_t eps4 = new_epsilon4();
+
+      clover_observables res = parallel_reduction::deterministic_sum<clover_observables>(
+        U.getVolume(), [&](const size_t &s) {
+          clover_observables o;
+          const accum *Gs = &F[s * np];
+          const double *Ps = &retrP[s * np];
+          for (size_t mu = 0; mu < d - 1; mu++) {
+            for (size_t nu = mu + 1; nu < d; nu++) {
+              // trace(G_{mu,nu}^a G_{mu,nu}^a)
+              const double e = retrace(Gs[plane(mu, nu, d)] * Gs[plane(mu, nu, d)]);
+              o.P += Ps[plane(mu, nu, d)];
+              o.E += e;
+              if (mu > 0) {
+                o.P_ss += Ps[plane(mu, nu, d)];
+                o.E_ss += e;
+              }
+            }
+          }
+          if (d == 4) {
+            for (int i = 0; i < eps4.N; i++) {
+              const int i1 = eps4.eps_idx[i][0], i2 = eps4.eps_idx[i][1];
+              const int i3 = eps4.eps_idx[i][2], i4 = eps4.eps_idx[i][3];
+              // only mu < nu and rho < sigma, the factor 4 is in the normalisation
+              if (i2 < i1 || i4 < i3) {
+                continue;
+              }
+              o.Q += eps4.eps_val[i] *
+                     retrace(Gs[plane(i1, i2, d)] * Gs[plane(i3, i4, d)]);
+            }
+          }
+          if (d == 2) {
+            o.Q += -std::imag(trace(Gs[0]));
+          }
+          return o;
+        });
+
+      // now we need to devide by 2, but we get a factor of two since we only
+      // averaged mu < nu. The clover leaves add a factor 1/16.
+      const double fac_E = (cloverdef ? 1.0 / 16.0 : 1.0) / U.getVolume();
+      res.E *= -fac_E;
+      res.E_ss *= -fac_E;
+      // factor 4 from summing only mu < nu and rho < sigma
+      res.Q *= -4.0 / (32.0 * M_PI * M_PI) * (cloverdef ? 1.0 / 16.0 : 1.0);
+      return res;
+    }
+
+  private:
+    bool cloverdef;
+    size_t revision = 0; // stamp of the configuration G belongs to
+    std::vector<accum> G;
+    std::vector<double> retrP; // Re(Tr(P_{mu nu}(x))), same layout as G
+
+    static size_t plane(const size_t &mu, const size_t &nu, const size_t &d) {
+      return mu * (2 * d - mu - 1) / 2 + (nu - mu - 1);
+    }
+
+    void compute(const gaugeconfig<Group> &U) {
+      const size_t d = U.getndims();
+      const size_t np = d * (d - 1) / 2;
+      const size_t V = U.getVolume();
+      const geometry g(U.getLx(), U.getLy(), U.getLz(), U.getLt());
+      G.resize(V * np);
+      retrP.resize(V * np);
+
+#pragma omp parallel for
+      for (size_t s = 0; s < V; s++) {
+        std::array<int, 4> x;
+        size_t r = s;
+        x[3] = r % g.getLz();
+        r /= g.getLz();
+        x[2] = r % g.getLy();
+        r /= g.getLy();
+        x[1] = r % g.getLx();
+        x[0] = r / g.getLx();
+
+        // link U_mu(x + a*mu + b*nu)
+        auto link = [&](const size_t &mu, const size_t &nu, const int &a, const int &b,
+                        const size_t &dir) {
+          std::array<int, 4> y = x;
+          y[mu] += a;
+          y[nu] += b;
+          return U[g.getIndex(y[0], y[1], y[2], y[3]) * d + dir];
+        };
+
+        for (size_t mu = 0; mu < d - 1; mu++) {
+          for (size_t nu = mu + 1; nu < d; nu++) {
+            const Group plaq = link(mu, nu, 0, 0, mu) * link(mu, nu, 1, 0, nu) *
+                               link(mu, nu, 0, 1, mu).dagger() *
+                               link(mu, nu, 0, 0, nu).dagger();
+            retrP[s * np + plane(mu, nu, d)] = retrace(plaq);
+            accum leaf = plaq;
+            if (cloverdef) {
+              leaf += link(mu, nu, 0, 0, nu) * link(mu, nu, -1, 1, mu).dagger() *
+                      link(mu, nu, -1, 0, nu).dagger() * link(mu, nu, -1, 0, mu);
+              leaf += link(mu, nu, -1, 0, mu).dagger() * link(mu, nu, -1, -1, nu).dagger() *
+                      link(mu, nu, -1, -1, mu) * link(mu, nu, 0, -1, nu);
+              leaf += link(mu, nu, 0, -1, nu).dagger() * link(mu, nu, 0, -1, mu) *
+                      link(mu, nu, 1, -1, nu) * link(mu, nu, 0, 0, mu).dagger();
+            }
+            // traceless and anti-hermitian, here we include a factor 1/2 already
+            G[s * np + plane(mu, nu, d)] = traceless_antiherm(leaf);
+          }
+        }
+      }
+    }
+  };
+
+} // namespace flat_spacetime
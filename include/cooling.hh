@@ -0,0 +1,77 @@
+/**
+ * @file cooling.hh
+ * @brief cooling of gauge configurations, for the topological charge
+ *
+ * Each link is replaced by the group element which minimises the local Wilson action,
+ * i.e. which maximises Re tr(U_mu(x) K_mu(x)) with K the sum of the staples (see
+ * get_staples()): U_mu(x) -> K_mu(x)^{\dagger}/|K_mu(x)|. With the relaxation parameter
+ * alpha the new link is the projection of (1-alpha)*U_mu(x) + alpha*K^{\dagger}/|K|
+ * onto the group: alpha=1 is the standard cooling, alpha < 1 removes the short
+ * distance fluctuations more slowly (under-relaxed cooling) and alpha > 1 overshoots
+ * (over-relaxed cooling). One sweep costs about as much as one force evaluation, a
+ * few sweeps are sufficient for a stable topological charge.
+ * The links are updated in place, parallelised as the Metropolis sweep: first all the
+ * even, then all the odd time slices (Lt has to be even).
+ */
+
+#pragma once
+
+#include "accum_type.hh"
+#include "gaugeconfig.hh"
+#include "get_staples.hh"
+#include "su2.hh"
+#include "u1.hh"
+
+#include <complex>
+#include <vector>
+
+namespace flat_spacetime {
+
+  // the element maximising Re tr(U*K), up to normalisation
+  inline Complex staple_dagger(const Complex &K) { return std::conj(K); }
+  inline _su2 staple_dagger(const _su2 &K) { return K.dagger(); }
+
+  /**
+   * @brief one cooling sweep over all the links of U
+   *
+   * @param U gauge configuration, cooled in place
+   * @param alpha relaxation parameter, 0 < alpha < 2
+   * @param xi bare anisotropy
+   * @param anisotropic true for the anisotropic Wilson action
+   */
+  template <class Group>
+  void cooling_sweep(gaugeconfig<Group> &U,
+                     const double &alpha = 1.0,
+                     const double &xi = 1.0,
+                     const bool &anisotropic = false) {
+    typedef typename accum_type<Group>::type accum;
+    for (size_t parity = 0; parity < 2; parity++) {
+#pragma omp parallel for
+      for (size_t x0 = parity; x0 < U.getLt(); x0 += 2) {
+        for (size_t x1 = 0; x1 < U.getLx(); x1++) {
+          for (size_t x2 = 0; x2 < U.getLy(); x2++) {
+            for (size_t x3 = 0; x3 < U.getLz(); x3++) {
+              std::vector<size_t> x = {x0, x1, x2, x3};
+              for (size_t mu = 0; mu < U.getndims(); mu++) {
+                accum K;
+                get_staples(K, U, x, mu, xi, anisotropic);
+                Group W(staple_dagger(K));
+                W.restoreSU();
+                if (alpha == 1.0) {
+                  U(x, mu) = W;
+                } else {
+                  Group Uprime((1.0 - alpha) * U(x, mu) + alpha * W);
+                  U(x, mu) = Uprime;
+                  U(x, mu).restoreSU();
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+    U.touch();
+    return;
+  }
+
+} // namespace flat_spacetime
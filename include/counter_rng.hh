@@ -0,0 +1,136 @@
+/**
+ * @file counter_rng.hh
+ * @brief counter-based random numbers for parallel field generation
+ *
+ * The Philox4x32-10 generator (J. K. Salmon et al., SC '11) maps a 128 bit counter
+ * and a 64 bit key to 128 random bits. Element i of a field uses counter i, hence
+ * each element can be generated independently by any thread and the result does not
+ * depend on the number of threads or on the order of evaluation.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace counter_rng {
+
+  using ctr_type = std::array<uint32_t, 4>;
+
+  inline void mulhilo(const uint32_t &a, const uint32_t &b, uint32_t &hi, uint32_t &lo) {
+    const uint64_t p = uint64_t(a) * uint64_t(b);
+    hi = uint32_t(p >> 32);
+    lo = uint32_t(p);
+  }
+
+  /**
+   * @brief Philox4x32 with 10 rounds
+   */
+  inline ctr_type philox4x32(ctr_type c, const uint64_t &key) {
+    uint32_t k0 = uint32_t(key), k1 = uint32_t(key >> 32);
+    for (size_t r = 0; r < 10; r++) {
+      if (r > 0) {
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+      }
+      uint32_t hi0, lo0, hi1, lo1;
+      mulhilo(0xD2511F53, c[0], hi0, lo0);
+      mulhilo(0xCD9E8D57, c[2], hi1, lo1);
+      c = {hi1 ^ c[1] ^ k0, lo1, hi0 ^ c[3] ^ k1, lo0};
+    }
+    return c;
+  }
+
+  /**
+   * @brief double in (0, 1] with 53 random bits from two 32 bit words
+   */
+  inline double to_uniform(const uint32_t &a, const uint32_t &b) {
+    const uint64_t x = (uint64_t(a >> 5) << 26) | uint64_t(b >> 6);
+    return (double(x) + 1.0) * (1.0 / 9007199254740992.0);
+  }
+
+  /**
+   * @brief 64 bit key for the counter-based streams drawn from a standard engine
+   */
+  template <class URNG> uint64_t draw_key(URNG &engine) {
+    const uint64_t a = uint64_t(engine()) & 0xFFFFFFFF;
+    const uint64_t b = uint64_t(engine()) & 0xFFFFFFFF;
+    return (a << 32) | b;
+  }
+
+  /**
+   * @brief standard normal numbers number first, ..., first+n-1 of the stream `key`
+   *
+   * Normal numbers 2p and 2p+1 are obtained with the Box-Muller transform from the
+   * two uniform numbers of counter p. The transform is done in blocks, such that the
+   * loop containing the transcendental functions can be vectorized.
+   */
+  inline void fill_normal(const uint64_t &key,
+                          const uint64_t &first,
+                          const size_t &n,
+                          double *out) {
+    constexpr size_t block = 128;
+    constexpr double two_pi = 6.283185307179586476925286766559;
+    double u1[block], u2[block], z0[block], z1[block];
+
+    const uint64_t p0 = first / 2, p1 = (first + n + 1) / 2;
+    for (uint64_t b = p0; b < p1; b += block) {
+      const size_t m = std::min(uint64_t(block), p1 - b);
+      for (size_t k = 0; k < m; k++) {
+        const uint64_t p = b + k;
+        const ctr_type r = philox4x32({uint32_t(p), uint32_t(p >> 32), 0, 0}, key);
+        u1[k] = to_uniform(r[0], r[1]);
+        u2[k] = to_uniform(r[2], r[3]);
+      }
+#pragma omp simd
+      for (size_t k = 0; k < m; k++) {
+        const double rho = std::sqrt(-2.0 * std::log(u1[k]));
+        z0[k] = rho * std::cos(two_pi * u2[k]);
+        z1[k] = rho * std::sin(two_pi * u2[k]);
+      }
+      for (size_t k = 0; k < m; k++) {
+        const uint64_t j = 2 * (b + k);
+        if (j >= first && j < first + n) {
+          out[j - first] = z0[k];
+        }
+        if (j + 1 >= first && j + 1 < first + n) {
+          out[j + 1 - first] = z1[k];
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief uniform random bit generator for the independent stream `stream` of `key`
+   * Can be used with the standard distributions, e.g. in random_element().
+   */
+  class philox_engine {
+  public:
+    using result_type = uint32_t;
+    philox_engine(const uint64_t &key, const uint64_t &stream)
+      : key(key), stream(stream), n(0), pos(4) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<uint32_t>::max(); }
+
+    result_type operator()() {
+      if (pos == 4) {
+        buf = philox4x32({uint32_t(stream), uint32_t(stream >> 32), uint32_t(n),
+                          uint32_t(n >> 32) | 0x80000000u},
+                         key);
+        n++;
+        pos = 0;
+      }
+      return buf[pos++];
+    }
+
+  private:
+    uint64_t key, stream, n;
+    size_t pos;
+    ctr_type buf;
+  };
+
+} // namespace counter_rng
@@ -17,6 +17,7 @@
 #include "monomial.hh"
 #include "su2.hh"
 #include "u1.hh"
+#include <algorithm>
 #include <array>
 #include <complex>
 #include <random>
@@ -27,9 +28,242 @@
 namespace staggered {
   template <class iT> using nd_max_arr = spacetime_lattice::nd_max_arr<iT>;
 
+  /**
+   * @brief solver iterations accumulated since the last reset
+   */
+  struct solver_stats {
+    size_t iterations = 0; // total number of iterations
+    size_t solves = 0; // number of solver calls
+
+    void add(const size_t &n) {
+      iterations += n;
+      solves++;
+    }
+    void reset() {
+      iterations = 0;
+      solves = 0;
+    }
+  };
+
+  /**
+   * @brief history of the last solutions of M*chi = psi along the MD trajectory
+   * The initial guess for the next solve is obtained by minimal residual extrapolation
+   * (R. C. Brower et al., https://arxiv.org/abs/hep-lat/9509012): chi_0 minimizes the
+   * M-norm of the error in the span of the stored solutions, i.e.
+   * chi_0 = \sum_i c_i q_i with (q_i^{\dagger} M q_j) c_j = q_i^{\dagger} psi,
+   * where q_i is an orthonormal basis of the history. This costs one application of M
+   * per stored solution.
+   */
+  template <typename Float> class chrono_history {
+    typedef std::complex<Float> Complex;
+    typedef staggered::spinor_lat<Float, Complex> spinor;
+
+    size_t N; // maximal number of stored solutions
+    std::vector<spinor> v; // stored solutions, the oldest first
+
+  public:
+    chrono_history(const size_t &_N = 0) : N(_N) {}
+
+    void reset() { v.clear(); }
+
+    size_t size() const { return v.size(); }
+
+    void push(const spinor &chi) {
+      if (N == 0) {
+        return;
+      }
+      if (v.size() == N) {
+        v.erase(v.begin());
+      }
+      v.push_back(chi);
+    }
+
+    /**
+     * @brief initial guess x0 for M*x = psi
+     * @return false when there is no history
+     */
+    template <class Group>
+    bool guess(const staggered::DDdag_matrix_lat<Float, Complex, Group> &M,
+               const spinor &psi,
+               spinor &x0) const {
+      // orthonormal basis with modified Gram-Schmidt, dropping (almost) linearly
+      // dependent vectors
+      std::vector<spinor> q;
+      for (size_t i = 0; i < v.size(); i++) {
+        spinor w = v[i];
+        const Float w_norm = w.norm();
+        for (size_t j = 0; j < q.size(); j++) {
+          w = a_plus_lambda_b(w, -complex_dot_product(q[j], w), q[j]);
+        }
+        const Float n = w.norm();
+        if (n > 1e-10 * w_norm && n > 0.) {
+          q.push_back(w / Complex(n));
+        }
+      }
+      const size_t n = q.size();
+      if (n == 0) {
+        return false;
+      }
+
+      // G*c = b with G_ij = q_i^{\dagger} M q_j, b_i = q_i^{\dagger} psi
+      std::vector<std::vector<Complex>> G(n, std::vector<Complex>(n + 1));
+      for (size_t j = 0; j < n; j++) {
+        const spinor Mq = M * q[j];
+        for (size_t i = 0; i < n; i++) {
+          G[i][j] = complex_dot_product(q[i], Mq);
+        }
+        G[j][n] = complex_dot_product(q[j], psi);
+      }
+      // Gaussian elimination with partial pivoting
+      for (size_t k = 0; k < n; k++) {
+        size_t p = k;
+        for (size_t i = k + 1; i < n; i++) {
+          if (std::abs(G[i][k]) > std::abs(G[p][k])) {
+            p = i;
+          }
+        }
+        std::swap(G[k], G[p]);
+        for (size_t i = k + 1; i < n; i++) {
+          const Complex f = G[i][k] / G[k][k];
+          for (size_t j = k; j <= n; j++) {
+            G[i][j] -= f * G[k][j];
+          }
+        }
+      }
+      std::vector<Complex> c(n);
+      for (size_t k = n; k-- > 0;) {
+        Complex r = G[k][n];
+        for (size_t j = k + 1; j < n; j++) {
+          r -= G[k][j] * c[j];
+        }
+        c[k] = r / G[k][k];
+      }
+
+      x0 = spinor(psi.get_dims());
+      for (size_t j = 0; j < n; j++) {
+        x0 = a_plus_lambda_b(x0, c[j], q[j]);
+      }
+      return true;
+    }
+
+    /**
+     * @brief solution of M*x = psi, starting from the extrapolated guess if available.
+     * The solution is added to the history and the iterations to `stats`.
+     */
+    template <class Group>
+    spinor solve(const staggered::DDdag_matrix_lat<Float, Complex, Group> &M,
+                 const spinor &psi,
+                 const std::string &solver,
+                 const Float &tol,
+                 const size_t &verb,
+                 const size_t &seed,
+                 solver_stats &stats) {
+      spinor x0;
+      spinor chi;
+      if (this->guess(M, psi, x0)) {
+        chi = M.inv(psi, x0, solver, tol, verb);
+      } else {
+        chi = M.inv(psi, solver, tol, verb, seed);
+      }
+      stats.add(M.iterations);
+      this->push(chi);
+      return chi;
+    }
+  };
+
+  /**
+   * @brief deriv += fac * d/dU [ -2 Re(a^{\dagger} * D * b) ]
+   * Building block of the pseudofermion forces: only the hopping part of D depends on
+   * the gauge field, hence the result does not depend on the mass.
+   */
+  template <typename Float, class Group>
+  void add_DDdag_force(adjointfield<Float, Group> &deriv,
+                       const gaugeconfig<Group> &U,
+                       const staggered::spinor_lat<Float, std::complex<Float>> &a,
+                       const staggered::spinor_lat<Float, std::complex<Float>> &b,
+                       const Float &fac) {
+    typedef typename accum_type<Group>::type accum;
+    const std::complex<Float> i(0.0, 1.0);
+
+    const size_t Lt = U.getLt(), Lx = U.getLx(), Ly = U.getLy(), Lz = U.getLz();
+    const size_t nd = U.getndims();
+
+//#pragma omp target teams distribute parallel for //collapse(4)
+// #pragma omp target teams distribute parallel for collapse(4)
+#pragma omp parallel for // collapse(4)
+    for (int x0 = 0; x0 < Lt; x0++) {
+      for (int x1 = 0; x1 < Lx; x1++) {
+        for (int x2 = 0; x2 < Ly; x2++) {
+          for (int x3 = 0; x3 < Lz; x3++) {
+            const nd_max_arr<int> x = {x0, x1, x2, x3};
+            nd_max_arr<int> xm = x, xp = x;
+            for (size_t mu = 0; mu < nd; mu++) {
+              accum derSF;
+              xm[mu]--; // x - mu
+              xp[mu]++; // x + mu
+
+              const Float eta_x_mu = staggered::eta(x, mu);
+              const Float eta_xp_mu = staggered::eta(xp, mu);
+
+              auto v_xp = (1.0 / 2.0) * eta_x_mu * (+i) * U(x, mu) * b(xp);
+              auto v_x = -(1.0 / 2.0) * eta_xp_mu * (-i) * U(x, mu).dagger() * b(x);
+
+              // derivative of S_F with respect to U_{\mu}(x)
+              derSF = conj(a(x)) * v_xp + conj(a(xp)) * v_x;
+              derSF =
+                -2.0 * i * derSF; // get_deriv gives the imaginary part: Re(z) = Im(i*z)
+              deriv(x, mu) += fac * get_deriv<Float>(derSF);
+
+              xm[mu]++; // =x again
+              xp[mu]--; // =x again
+            }
+          }
+        }
+      }
+    }
+    return;
+  }
+
+  /**
+   * @brief base class of the pseudo-fermion monomials: parameters of the solver
+   * The action (heatbath and accept/reject step) and the force (MD evolution) have
+   * separate tolerances: an error in the force only spoils the energy conservation of
+   * the integrator, while the action has to be precise for an exact Metropolis step.
+   */
+  template <typename Float, class Group>
+  class fermion_monomial : public monomial<Float, Group> {
+  public:
+    std::string SOLVER; // type of the SOLVER
+    Float TOLERANCE; // tolerance of the solver for the action
+    Float TOLERANCE_FORCE; // tolerance of the solver for the force
+    size_t VERBOSITY; // verbosity of the solver
+    size_t SEED; // seed of the random number generator
+
+    mutable solver_stats stats_action; // iterations in heatbath and accept
+    mutable solver_stats stats_force; // iterations in the force
+
+    fermion_monomial(unsigned int _timescale,
+                     const std::string &solver,
+                     const Float &tolerance,
+                     const size_t &seed,
+                     const size_t &verb)
+      : monomial<Float, Group>::monomial(_timescale) {
+      SOLVER = solver;
+      TOLERANCE = tolerance;
+      TOLERANCE_FORCE = tolerance;
+      SEED = seed;
+      VERBOSITY = verb;
+    }
+
+    void set_tolerances(const Float &tol_action, const Float &tol_force) {
+      TOLERANCE = tol_action;
+      TOLERANCE_FORCE = tol_force;
+    }
+  };
+
   // detDDdag monomial : evaluation of det(D*D^{\dagger}) through pseudo-fermions
   template <typename Float, class Group>
-  class detDDdag_monomial : public monomial<Float, Group> {
+  class detDDdag_monomial : public fermion_monomial<Float, Group> {
     typedef std::complex<Float> Complex;
 
     size_t n_traj = 0;
@@ -37,27 +271,22 @@ namespace staggered {
   public:
     Float m0; // bare mass (in lattice units)
 
-    std::string SOLVER; // type of the SOLVER
-    Float TOLERANCE; // tolerance of the CG solver
-    size_t VERBOSITY; // verbosity of the CG solver
-    size_t SEED; // seed of the random number generator
-
     // pseudo-fermion field phi, kept constant along the MD trajectory
     staggered::spinor_lat<Float, Complex> phi;
 
+    // last solutions of (D*D^{\dagger}) chi = phi in the current trajectory
+    mutable chrono_history<Float> history;
+
     detDDdag_monomial<Float, Group>(unsigned int _timescale,
                                     const Float &m0_val,
                                     const std::string &solver,
                                     const Float &tolerance,
                                     const size_t &seed,
-                                    const size_t &verb)
-      : monomial<Float, Group>::monomial(_timescale) {
+                                    const size_t &verb,
+                                    const size_t &n_chrono = 0)
+      : fermion_monomial<Float, Group>(_timescale, solver, tolerance, seed, verb),
+        history(n_chrono) {
       m0 = m0_val;
-
-      SOLVER = solver;
-      TOLERANCE = tolerance;
-      SEED = seed;
-      VERBOSITY = verb;
     }
 
     // during the heatbath we generate R and store phi
@@ -72,11 +301,12 @@ namespace staggered {
 
       const staggered::spinor_lat<Float, Complex> R =
         staggered::gaussian_spinor<Float, Complex>(
-          dims, 0.0, 1.0 / sqrt(2), SEED + n_traj); // e^{-x^2} has sigma=1/sqrt(2)
+          dims, 0.0, 1.0 / sqrt(2), (*this).SEED + n_traj); // e^{-x^2} has sigma=1/sqrt(2)
 
       n_traj += 1;
 
       (*this).phi = staggered::apply_D<Float, Complex>(*h.U, (*this).m0, R);
+      (*this).history.reset(); // new phi: old solutions are useless
 
       monomial<Float, Group>::Hold = R.norm_squared(); // R^{\dagger}*R is real
       return;
@@ -92,11 +322,12 @@ namespace staggered {
      */
     void accept(const hamiltonian_field<Float, Group> &h) override {
       // Operator D*D^{\dagger} . Hermitian and invertible -> can apply the CG inversion
-      const staggered::DDdag_matrix_lat<Float, Complex, _u1> DDdag(*h.U, (*this).m0);
+      const staggered::DDdag_matrix_lat<Float, Complex, Group> DDdag(*h.U, (*this).m0);
 
       // applying (D*Ddag)^{-1} to \phi
-      const staggered::spinor_lat<Float, Complex> chi =
-        DDdag.inv((*this).phi, SOLVER, TOLERANCE, VERBOSITY, SEED);
+      const staggered::spinor_lat<Float, Complex> chi = (*this).history.solve(
+        DDdag, (*this).phi, (*this).SOLVER, (*this).TOLERANCE, (*this).VERBOSITY,
+        (*this).SEED, (*this).stats_action);
 
       monomial<Float, Group>::Hnew = complex_dot_product(phi, chi).real();
       return;
@@ -112,71 +343,31 @@ namespace staggered {
     void derivative(adjointfield<Float, Group> &deriv,
                     const hamiltonian_field<Float, Group> &h,
                     const Float fac = 1.) const override {
-      typedef typename accum_type<Group>::type accum;
-
       const staggered::DDdag_matrix_lat<Float, Complex, Group> DDdag(*h.U, (*this).m0);
 
-      const staggered::spinor_lat<Float, Complex> chi =
-        DDdag.inv((*this).phi, SOLVER, TOLERANCE, VERBOSITY, SEED);
-
-      const size_t Lt = h.U->getLt(), Lx = h.U->getLx(), Ly = h.U->getLy(),
-                   Lz = h.U->getLz();
-      const size_t nd = h.U->getndims();
+      const staggered::spinor_lat<Float, Complex> chi = (*this).history.solve(
+        DDdag, (*this).phi, (*this).SOLVER, (*this).TOLERANCE_FORCE, (*this).VERBOSITY,
+        (*this).SEED, (*this).stats_force);
 
       const staggered::spinor_lat<Float, Complex> chi1 =
         staggered::apply_Ddag(*h.U, (*this).m0, chi);
 
-      const Complex i(0.0, 1.0);
-
-//#pragma omp target teams distribute parallel for //collapse(4)
-// #pragma omp target teams distribute parallel for collapse(4)
-#pragma omp parallel for // collapse(4)
-      for (int x0 = 0; x0 < Lt; x0++) {
-        for (int x1 = 0; x1 < Lx; x1++) {
-          for (int x2 = 0; x2 < Ly; x2++) {
-            for (int x3 = 0; x3 < Lz; x3++) {
-              const nd_max_arr<int> x = {x0, x1, x2, x3};
-              nd_max_arr<int> xm = x, xp = x;
-              for (size_t mu = 0; mu < nd; mu++) {
-                accum derSF;
-                xm[mu]--; // x - mu
-                xp[mu]++; // x + mu
-
-                const Float eta_x_mu = staggered::eta(x, mu);
-                const Float eta_xp_mu = staggered::eta(xp, mu);
-
-                auto v_xp = (1.0 / 2.0) * eta_x_mu * (+i) * (*h.U)(x, mu) * chi1(xp);
-                auto v_x =
-                  -(1.0 / 2.0) * eta_xp_mu * (-i) * (*h.U)(x, mu).dagger() * chi1(x);
-
-                // derivative of S_F with respect to U_{\mu}(x)
-                derSF = conj(chi(x)) * v_xp + conj(chi(xp)) * v_x;
-                derSF =
-                  -2.0 * i * derSF; // get_deriv gives the imaginary part: Re(z) = Im(i*z)
-                // std::cout << "derSF : " << derSF << "\n";
-                deriv(x, mu) += get_deriv<Float>(derSF);
-
-                xm[mu]++; // =x again
-                xp[mu]--; // =x again
-              }
-            }
-          }
-        }
-      }
+      add_DDdag_force(deriv, *h.U, chi, chi1, fac);
       return;
     }
   };
 
   template <typename Float>
-  class detDDdag_monomial<Float, _su2> : public monomial<Float, _su2> {
+  class detDDdag_monomial<Float, _su2> : public fermion_monomial<Float, _su2> {
   public:
     detDDdag_monomial(unsigned int _timescale,
                       const Float &m0_val,
                       const std::string &solver,
                       const Float &tolerance,
                       const size_t &seed,
-                      const size_t &verb)
-      : monomial<Float, _su2>::monomial(_timescale) {
+                      const size_t &verb,
+                      const size_t & = 0)
+      : fermion_monomial<Float, _su2>(_timescale, solver, tolerance, seed, verb) {
       spacetime_lattice::fatal_error("SU(2) not supported yet.", __func__);
     }
 
@@ -191,4 +382,127 @@ namespace staggered {
     }
   };
 
+  /**
+   * @brief Hasenbusch ratio det(D*D^{\dagger}(m0)) / det(D*D^{\dagger}(m1))
+   * With M_i = D_i*D_i^{\dagger}, D_i = D(m_i), the pseudo-fermion action is
+   * S_F = \phi^{\dagger} * D_1 * M_0^{-1} * D_1^{\dagger} * \phi
+   * (see M. Hasenbusch, Phys. Lett. B 519 (2001) 177).
+   * For m1 > m0 the force is much smaller than the one of det(M_0) alone.
+   */
+  template <typename Float, class Group>
+  class detratio_monomial : public fermion_monomial<Float, Group> {
+    typedef std::complex<Float> Complex;
+
+    size_t n_traj = 0;
+
+  public:
+    Float m0; // mass in the numerator (light)
+    Float m1; // mass in the denominator (heavy)
+
+    // pseudo-fermion field phi, kept constant along the MD trajectory
+    staggered::spinor_lat<Float, Complex> phi;
+
+    // last solutions of (D_0*D_0^{\dagger}) chi = D_1^{\dagger} phi in the trajectory
+    mutable chrono_history<Float> history;
+
+    detratio_monomial<Float, Group>(unsigned int _timescale,
+                                    const Float &m0_val,
+                                    const Float &m1_val,
+                                    const std::string &solver,
+                                    const Float &tolerance,
+                                    const size_t &seed,
+                                    const size_t &verb,
+                                    const size_t &n_chrono = 0)
+      : fermion_monomial<Float, Group>(_timescale, solver, tolerance, seed, verb),
+        history(n_chrono) {
+      m0 = m0_val;
+      m1 = m1_val;
+    }
+
+    // phi = (D_1^{\dagger})^{-1} * D_0 * R = M_1^{-1} * D_1 * D_0 * R, then S_F = R^{\dagger}*R
+    void heatbath(const hamiltonian_field<Float, Group> &h) override {
+      const size_t Lt = h.U->getLt(), Lx = h.U->getLx(), Ly = h.U->getLy(),
+                   Lz = h.U->getLz();
+      const nd_max_arr<size_t> dims = {Lt, Lx, Ly, Lz}; // vactor of spacetime dimensions
+
+      const staggered::spinor_lat<Float, Complex> R =
+        staggered::gaussian_spinor<Float, Complex>(
+          dims, 0.0, 1.0 / sqrt(2), (*this).SEED + n_traj); // e^{-x^2} has sigma=1/sqrt(2)
+
+      n_traj += 1;
+
+      const staggered::DDdag_matrix_lat<Float, Complex, Group> M1(*h.U, (*this).m1);
+      const staggered::spinor_lat<Float, Complex> D1D0R = staggered::apply_D<Float, Complex>(
+        *h.U, (*this).m1, staggered::apply_D<Float, Complex>(*h.U, (*this).m0, R));
+      (*this).phi =
+        M1.inv(D1D0R, (*this).SOLVER, (*this).TOLERANCE, (*this).VERBOSITY, (*this).SEED);
+      (*this).stats_action.add(M1.iterations);
+      (*this).history.reset();
+
+      monomial<Float, Group>::Hold = R.norm_squared(); // R^{\dagger}*R is real
+      return;
+    }
+
+    void accept(const hamiltonian_field<Float, Group> &h) override {
+      const staggered::DDdag_matrix_lat<Float, Complex, Group> M0(*h.U, (*this).m0);
+
+      const staggered::spinor_lat<Float, Complex> psi =
+        staggered::apply_Ddag(*h.U, (*this).m1, (*this).phi);
+      const staggered::spinor_lat<Float, Complex> chi =
+        (*this).history.solve(M0, psi, (*this).SOLVER, (*this).TOLERANCE,
+                              (*this).VERBOSITY, (*this).SEED, (*this).stats_action);
+
+      monomial<Float, Group>::Hnew = complex_dot_product(psi, chi).real();
+      return;
+    }
+
+    /**
+     * \psi = D_1^{\dagger} * \phi, \chi = M_0^{-1} * \psi
+     * dS_F = 2 Re(\phi^{\dagger} * dD * \chi) - 2 Re(\chi^{\dagger} * dD * D_0^{\dagger} * \chi)
+     */
+    void derivative(adjointfield<Float, Group> &deriv,
+                    const hamiltonian_field<Float, Group> &h,
+                    const Float fac = 1.) const override {
+      const staggered::DDdag_matrix_lat<Float, Complex, Group> M0(*h.U, (*this).m0);
+
+      const staggered::spinor_lat<Float, Complex> psi =
+        staggered::apply_Ddag(*h.U, (*this).m1, (*this).phi);
+      const staggered::spinor_lat<Float, Complex> chi =
+        (*this).history.solve(M0, psi, (*this).SOLVER, (*this).TOLERANCE_FORCE,
+                              (*this).VERBOSITY, (*this).SEED, (*this).stats_force);
+      const staggered::spinor_lat<Float, Complex> chi1 =
+        staggered::apply_Ddag(*h.U, (*this).m0, chi);
+
+      add_DDdag_force(deriv, *h.U, chi, chi1, fac);
+      add_DDdag_force(deriv, *h.U, (*this).phi, chi, -fac);
+      return;
+    }
+  };
+
+  template <typename Float>
+  class detratio_monomial<Float, _su2> : public fermion_monomial<Float, _su2> {
+  public:
+    detratio_monomial(unsigned int _timescale,
+                      const Float &,
+                      const Float &,
+                      const std::string &solver,
+                      const Float &tolerance,
+                      const size_t &seed,
+                      const size_t &verb,
+                      const size_t & = 0)
+      : fermion_monomial<Float, _su2>(_timescale, solver, tolerance, seed, verb) {
+      spacetime_lattice::fatal_error("SU(2) not supported yet.", __func__);
+    }
+
+    void heatbath(const hamiltonian_field<Float, _su2> &) override { return; }
+
+    void accept(const hamiltonian_field<Float, _su2> &) override { return; }
+
+    void derivative(adjointfield<Float, _su2> &,
+                    const hamiltonian_field<Float, _su2> &,
+                    const Float = 1.) const override {
+      return;
+    }
+  };
+
 } // namespace staggered
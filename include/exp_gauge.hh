@@ -9,3 +9,18 @@ _su2 exp(adjointsu2<double> const & x);
 inline _u1 exp(adjointu1<double> const & x) {
   return _u1(x.geta());
 }
+
+/**
+ * @brief batched exponential map: U[i] = exp(dtau*P[i]) * U[i] for i = 0, ..., n-1
+ * if restore is true, the links are projected back to the group afterwards
+ */
+void exp_and_multiply(const size_t n, const double dtau,
+                      const adjointsu2<double> * P, _su2 * U, const bool restore = false);
+
+inline void exp_and_multiply(const size_t n, const double dtau,
+                             const adjointu1<double> * P, _u1 * U, const bool restore = false) {
+  for(size_t i = 0; i < n; i++) {
+    U[i] = _u1(dtau*P[i].geta()) * U[i];
+    if(restore) U[i].restoreSU();
+  }
+}
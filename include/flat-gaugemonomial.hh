@@ -18,6 +18,7 @@
 #include "get_staples.hh"
 #include "hamiltonian_field.hh"
 #include "monomial.hh"
+#include "plaquette_field.hh"
 #include "su2.hh"
 #include "u1.hh"
 
@@ -92,49 +93,42 @@ namespace flat_spacetime {
     }
     // S_g = sum_x sum_{mu<nu} beta*(1- 1/Nc*Re[Tr[U_{mu nu}]])
     // beta = 2*N_c/g_0^2
+    // the plaquettes are taken from the cache, see plaquette_field.hh
     void heatbath(hamiltonian_field<Float, Group> const &h) override {
       monomial<Float, Group>::Hold =
-        flat_spacetime::get_S_G_hmc<Float, Group>(*h.U, (*this).xi, (*this).anisotropic);
+        -h.U->getBeta() * plaquettes.retr_sum(*h.U, (*this).xi, (*this).anisotropic) /
+        double(h.U->getNc());
       return;
     }
     void accept(hamiltonian_field<Float, Group> const &h) override {
       monomial<Float, Group>::Hnew =
-        flat_spacetime::get_S_G_hmc<Float, Group>(*h.U, (*this).xi, (*this).anisotropic);
+        -h.U->getBeta() * plaquettes.retr_sum(*h.U, (*this).xi, (*this).anisotropic) /
+        double(h.U->getNc());
       return;
     }
+    // the antihermitian traceless part of beta/N_c * U*U^stap, with U*U^stap the sum of
+    // the plaquettes containing the link
     void derivative(adjointfield<Float, Group> &deriv,
                     hamiltonian_field<Float, Group> const &h,
                     const Float fac = 1.) const override {
-      typedef typename accum_type<Group>::type accum;
-#pragma omp parallel for
-      for (size_t x0 = 0; x0 < h.U->getLt(); x0++) {
-        for (size_t x1 = 0; x1 < h.U->getLx(); x1++) {
-          for (size_t x2 = 0; x2 < h.U->getLy(); x2++) {
-            for (size_t x3 = 0; x3 < h.U->getLz(); x3++) {
-              std::vector<size_t> x = {x0, x1, x2, x3};
-              for (size_t mu = 0; mu < h.U->getndims(); mu++) {
-                accum S;
-                get_staples(S, *h.U, x, mu, (*this).xi, (*this).anisotropic);
-                S = (*h.U)(x, mu) * S;
-                // the antihermitian traceless part
-                // beta/N_c *(U*U^stap - (U*U^stap)^dagger)
-                // in get_deriv
-
-                deriv(x, mu) +=
-                  fac * h.U->getBeta() / double(h.U->getNc()) * get_deriv<double>(S);
-              }
-            }
-          }
-        }
-      }
+      plaquettes.add_force(deriv, *h.U, fac, (*this).xi, (*this).anisotropic);
       return;
     }
 
+    /**
+     * @brief plaquette cache of the monomial
+     * Can be used for the plaquette energy of the configurations seen by the monomial
+     * (e.g. after a trajectory), where the plaquettes are usually already known.
+     */
+    plaquette_field<Group> &get_plaquettes() const { return plaquettes; }
+
   private:
     // size_t Dims_fact; // d*(d-1)/2
 
     bool anisotropic = false;
     double xi; // bare anisotropy xi
+
+    mutable plaquette_field<Group> plaquettes; // plaquettes of the last configurations
   };
 
 } // namespace flat_spacetime
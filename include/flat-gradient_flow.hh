@@ -4,20 +4,35 @@
 #include "flat-energy_density.hh"
 #include "flat-gauge_energy.hpp"
 #include "flat-gaugemonomial.hh"
+#include "flow_checkpoint.hh"
 #include "gaugeconfig.hh"
 #include "hamiltonian_field.hh"
 #include "monomial.hh"
 #include "su2.hh"
 #include "update_gauge.hh"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iomanip>
+#include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
+/**
+ * @brief one step of the third order Runge-Kutta integration of the Wilson flow
+ * If W0 and A are given, the second order solution V' = exp(2 Z1 - Z0) W0 is built
+ * from the same stages (arxiv:1301.4388) and the distance max_{x,mu} |V_mu(x) - V'_mu(x)|
+ * is returned as estimate of the local error, otherwise 0 is returned.
+ * On return W0 holds the field before the step, A is used as workspace.
+ */
 template <typename Float, class Group>
-void runge_kutta(hamiltonian_field<Float, Group> &h,
-                 monomial<Float, Group> &SW,
-                 const double eps) {
+double runge_kutta(hamiltonian_field<Float, Group> &h,
+                   monomial<Float, Group> &SW,
+                   const double eps,
+                   gaugeconfig<Group> *W0 = nullptr,
+                   adjointfield<Float, Group> *A = nullptr) {
   double zfac[5] = {(-17.0) / (36.0), (8.0) / (9.0), (-3.0) / (4.0)};
   double expfac[3] = {-36.0 / 4. / 17.0, 1., -1.};
 
@@ -31,6 +46,11 @@ void runge_kutta(hamiltonian_field<Float, Group> &h,
   // Zi = eps*Z(Wi)
   // before the three steps zero the derivative field
   zeroadjointfield(*(h.momenta));
+  const bool estimate = (W0 != nullptr && A != nullptr);
+  if (estimate) {
+    *W0 = *(h.U);
+  }
+  const size_t N = h.momenta->getSize();
 
   for (int f = 0; f < 3; f++) {
     // add to *(h.momenta)
@@ -42,30 +62,187 @@ void runge_kutta(hamiltonian_field<Float, Group> &h,
     // we sum over unoriented plaquettes, so we have to multiply by 2
     // which is usually in beta
     SW.derivative(*(h.momenta), h, 2. * h.U->getNc() * zfac[f] / h.U->getBeta());
+    if (estimate && f == 0) {
+      *A = *(h.momenta); // zfac[0]*D0, with Z0 = -eps*D0
+    }
+    if (estimate && f == 1) {
+      // 2*D1 - D0 from zfac[0]*D0 and zfac[0]*D0 + zfac[1]*D1, i.e.
+      // 2/zfac[1] * (zfac[0]*D0 + zfac[1]*D1) - (2/zfac[1] + 1/zfac[0]) * zfac[0]*D0
+#pragma omp parallel for
+      for (size_t i = 0; i < N; i++) {
+        (*A)[i] = Float(-2.0 / zfac[1] - 1.0 / zfac[0]) * (*A)[i];
+        (*A)[i] += Float(2.0 / zfac[1]) * (*(h.momenta))[i];
+      }
+    }
     // The '-' comes from the action to be tr(1-U(p))
     // update the flowed gauge field Vt
     update_gauge(h, -eps * expfac[f]);
   }
-  return;
+  if (!estimate) {
+    return 0.;
+  }
+
+  double dmax = 0.;
+#pragma omp parallel for reduction(max : dmax)
+  for (size_t i = 0; i < N; i++) {
+    const Group Vp = exp(Float(-eps) * (*A)[i]) * (*W0)[i];
+    dmax = std::max(dmax, link_distance2((*(h.U))[i], Vp));
+  }
+  return std::sqrt(dmax);
 }
 
 namespace flat_spacetime {
 
+  /**
+   * @brief print one line of the gradient flow output: t xi P P_ss Ep Ep_ss Ec Ec_ss Q
+   * (see gradient_flow())
+   */
+  template <class Group>
+  void print_flow_observables(std::ostream &os,
+                              const gaugeconfig<Group> &U,
+                              const double &t,
+                              const clover_observables &obs) {
+    const size_t d = U.getndims();
+    const double ndims_fact = spacetime_lattice::num_pLloops_half(d);
+    const double ndims_fact_ss = spacetime_lattice::num_pLloops_half(d - 1);
+    const double den_common = U.getVolume() * double(U.getNc());
+
+    const double Ep = ndims_fact - obs.P / den_common;
+    const double Ep_ss = ndims_fact_ss - obs.P_ss / den_common;
+
+    const double Ep_ts = Ep - Ep_ss;
+
+    const double Ep_ts_bar = Ep_ts / (d - 1);
+    const double Ep_ss_bar = Ep_ss / ndims_fact_ss;
+
+    const double xi2_R = Ep_ts_bar / Ep_ss_bar;
+    const double xi_R = sqrt(xi2_R);
+
+    os << std::scientific; // using scientific notation
+    os.precision(16);
+    os << t << " ";
+    os << xi_R << " ";
+    os << obs.P / den_common << " " << obs.P_ss / den_common << " ";
+    os << Ep << " " << Ep_ss << " ";
+    os << obs.E << " " << obs.E_ss << " ";
+    os << obs.Q << "\n";
+  }
+
+  // header of the gradient flow output
+  inline void print_flow_header(std::ostream &os) {
+    os << "t "; // flow time
+    os << "xi "; // e_ts(t)/e_ss(t)
+    os << "P P_ss "; // plaquette
+    os << "Ep Ep_ss "; // energy from regular plaquette
+    os << "Ec Ec_ss "; // energy from clover-leaf plaquette
+    os << "Q" << std::endl;
+  }
+
+  /**
+   * @brief weights of the Lagrange interpolation through the nodes ts at t:
+   * f(t) = \sum_j w_j f(ts[j])
+   */
+  inline std::vector<double> lagrange_weights(const std::vector<double> &ts,
+                                              const double &t) {
+    std::vector<double> w(ts.size(), 1.0);
+    for (size_t j = 0; j < ts.size(); j++) {
+      for (size_t k = 0; k < ts.size(); k++) {
+        if (k != j) {
+          w[j] *= (t - ts[k]) / (ts[j] - ts[k]);
+        }
+      }
+    }
+    return w;
+  }
+
+  /**
+   * @brief weights of the derivative of the Lagrange interpolation at t:
+   * f'(t) = \sum_j w_j f(ts[j])
+   */
+  inline std::vector<double> lagrange_derivative_weights(const std::vector<double> &ts,
+                                                         const double &t) {
+    std::vector<double> w(ts.size(), 0.0);
+    for (size_t j = 0; j < ts.size(); j++) {
+      for (size_t m = 0; m < ts.size(); m++) {
+        if (m == j) {
+          continue;
+        }
+        double p = 1.0 / (ts[j] - ts[m]);
+        for (size_t k = 0; k < ts.size(); k++) {
+          if (k != j && k != m) {
+            p *= (t - ts[k]) / (ts[j] - ts[k]);
+          }
+        }
+        w[j] += p;
+      }
+    }
+    return w;
+  }
+
+  /**
+   * @brief Lagrange interpolation of the observables at flow time t
+   * through the points (ts[j], obs[j]), j=0,...,ts.size()-1
+   */
+  inline clover_observables interpolate_flow_observables(
+    const std::vector<double> &ts,
+    const std::vector<clover_observables> &obs,
+    const double &t) {
+    const std::vector<double> w = lagrange_weights(ts, t);
+    clover_observables res;
+    for (size_t j = 0; j < ts.size(); j++) {
+      res.P += w[j] * obs[j].P;
+      res.P_ss += w[j] * obs[j].P_ss;
+      res.E += w[j] * obs[j].E;
+      res.E_ss += w[j] * obs[j].E_ss;
+      res.Q += w[j] * obs[j].Q;
+    }
+    return res;
+  }
+
+  // append (tstart > 0) or write the output, and the checkpoint path + ".ckpt"
+  template <class Group>
+  void write_flow_output(const std::string &path,
+                         const std::string &out,
+                         const double &tstart,
+                         const bool &save_config,
+                         const gaugeconfig<Group> &Vt,
+                         const flow_state &state) {
+    std::ofstream ofs;
+    if (tstart == 0.0) {
+      ofs.open(path, std::ios::out);
+    } else {
+      ofs.open(path, std::ios::app);
+    }
+
+    ofs << out;
+    if (save_config) {
+      save_flow_checkpoint(path + ".ckpt", Vt, state);
+    }
+  }
+
   /**
    * @brief Printing Wilson gradient flow evolution on 'path'
    * Prints a dataframe for the Wilson flow evolution of
-   * flowtime, Plaquette(full, spatial-spatial, temporaVt-save(path+".conf"); ial),
+   * flowtime, Plaquette(full, spatial-spatial, temporal),
    * Energy_plaquette(...), Energy_clover[improved formula](...), etc. Notes:
    * - Each type of plaquette has limit 1 --> different normalization factors for P_ss and
    * P_ts.
    * - E_i = 1 - P_i, i="","ss","ts"
    * - E = E_ss + E_ts
+   * All the observables of a flow time come from a single pass over the lattice (see
+   * clover_field.hh). By default they are printed at every other integration step,
+   * t = tstart + eps, tstart + 3*eps, ... If measure_times is not empty, they are
+   * computed and printed only at the integration steps closest to the given times.
    * @tparam Group
    * @param U
    * @param path
    * @param tstart 1st value of flow time (when loading flowed gauge configuration)
    * @param tmax
    * @param eps
+   * @param save_config write the checkpoint path + ".ckpt" at the end (see
+   * flow_checkpoint.hh)
+   * @param measure_times flow times where the observables are measured
+   * @param state if given, state of the flow at tstart on entry and at the end on return
    */
   template <class Group>
   void gradient_flow(const gaugeconfig<Group> &U,
@@ -74,37 +251,27 @@ namespace flat_spacetime {
                      const double &eps,
                      const double &xi,
                      const double &tstart,
-                     const bool &save_config) {
+                     const bool &save_config,
+                     const std::vector<double> &measure_times = {},
+                     flow_state *state = nullptr) {
     const size_t d = U.getndims();
-    const double ndims_fact = spacetime_lattice::num_pLloops_half(d);
-    const double ndims_fact_ss = spacetime_lattice::num_pLloops_half(d - 1);
-
-    double t[3];
-    double P[3], E[3], Q[3];
-    double P_ss[3], E_ss[3], Q_ss[3]; // spatial-spatial contribution
+    flow_state st = (state != nullptr) ? *state : flow_state();
 
     std::ostringstream oss;
+    clover_field<Group> G;
 
-    double density = 0., topQ = 0.; // dummy variables
-    double density_ss = 0., topQ_ss = 0.; // dummy variables
-    for (unsigned int i = 0; i < 3; i++) {
-      t[i] = tstart;
-      P[i] = 0.;
-      E[i] = 0.;
-      Q[i] = 0.;
-      P_ss[i] = 0.;
-      E_ss[i] = 0.;
-      Q_ss[i] = 0.;
-    }
-
-    const double den_common = U.getVolume() * double(U.getNc());
-
-    P[2] = flat_spacetime::gauge_energy(U) / den_common;
-    P_ss[2] = flat_spacetime::gauge_energy(U, true) / den_common;
-    flat_spacetime::energy_density(U, density, topQ);
-    E[2] = density;
-    flat_spacetime::energy_density(U, density_ss, topQ_ss, true, true);
-    E_ss[2] = density_ss;
+    // true if the observables are needed after the integration step to t
+    auto measure_now = [&](const double &t, const unsigned int &x0) {
+      if (measure_times.empty()) {
+        return x0 == 1;
+      }
+      for (size_t k = 0; k < measure_times.size(); k++) {
+        if (std::abs(t - measure_times[k]) < eps / 2.0) {
+          return true;
+        }
+      }
+      return false;
+    };
 
     // definine a fictitious gauge configuration Vt, momenta and hamiltonian field to
     // evolve with the flow
@@ -114,86 +281,293 @@ namespace flat_spacetime {
     gaugemonomial<double, Group> SW(0, xi); // Wilson (pure) gauge action
 
     if (tstart == 0.0) {
-      oss << "t "; // flow time
-      oss << "xi "; // e_ts(t)/e_ss(t)
-      oss << "P P_ss "; // plaquette
-      oss << "Ep Ep_ss "; // energy from regular plaquette
-      oss << "Ec Ec_ss "; // energy from clover-leaf plaquette
-      oss << "Q" << std::endl;
+      print_flow_header(oss);
     }
 
-    // evolution of t[1] until tmax
+    // evolution of t[1] until tmax, two integration steps at a time
     //(note: eps=0.01 and tmax>0 --> the loop ends at some point)
-    // at each step we consider a triplet of values for t,P,E,Q
-
+    double t[3] = {tstart, tstart, tstart};
     while (t[1] < tmax - eps) {
-      // splicing the results at t[2] to the new 0-th temporal time slice
       t[0] = t[2];
-      P[0] = P[2];
-      E[0] = E[2];
-      Q[0] = Q[2];
-      P_ss[0] = P_ss[2];
-      E_ss[0] = E_ss[2];
-
       for (unsigned int x0 = 1; x0 < 3; x0++) {
         t[x0] = t[x0 - 1] + eps;
         runge_kutta(h, SW, eps); // apply Runge-Kutta integration method
-        P[x0] = flat_spacetime::gauge_energy(Vt) / den_common;
-        P_ss[x0] = flat_spacetime::gauge_energy(Vt, true) / den_common;
-        flat_spacetime::energy_density(Vt, density, topQ, true);
-        E[x0] = density;
-        Q[x0] = topQ;
-        flat_spacetime::energy_density(Vt, density_ss, topQ_ss, true, true);
-        E_ss[x0] = density_ss;
+        st.n_steps++;
+        if (measure_now(t[x0], x0)) {
+          const clover_observables obs = G.observables(Vt);
+          print_flow_observables(oss, Vt, t[x0], obs);
+          st.add_point(t[x0], obs);
+        }
+      }
+    }
+    st.t = t[2];
+    st.eps = eps;
+
+    write_flow_output(path, oss.str(), tstart, save_config, Vt, st);
+    if (state != nullptr) {
+      *state = st;
+    }
+    return;
+  }
+
+  /**
+   * @brief Wilson gradient flow with adaptive integration step
+   * Same output as gradient_flow(), but the step size is chosen such that the local
+   * error of the third order Runge-Kutta step, estimated from the embedded second order
+   * solution (see runge_kutta()), stays below `tolerance`:
+   * eps -> eps * min(2, max(0.2, 0.95*(tolerance/err)^(1/3))), rejecting the step if
+   * err > tolerance. The steps grow quickly at large flow time, where the field is
+   * smooth. The last step ends exactly at tmax.
+   * The observables are computed after the accepted steps close to an output time and
+   * interpolated (quadratically, through the last three points) to the output times:
+   * measure_times if given, otherwise the times t = tstart + eps, tstart + 3*eps, ... of
+   * gradient_flow().
+   * @param eps initial step size and spacing of the default output times
+   * @param tolerance maximal error per step, max_{x,mu} |V_mu(x) - V'_mu(x)|
+   * @param state if given, state of the flow at tstart on entry (the step size and the
+   * last points are reused) and at the end on return
+   */
+  template <class Group>
+  void gradient_flow_adaptive(const gaugeconfig<Group> &U,
+                              std::string const &path,
+                              const double &tmax,
+                              const double &eps,
+                              const double &xi,
+                              const double &tstart,
+                              const bool &save_config,
+                              const double &tolerance,
+                              const std::vector<double> &measure_times = {},
+                              flow_state *state = nullptr) {
+    const size_t d = U.getndims();
+    flow_state st = (state != nullptr) ? *state : flow_state();
+    const double t_eps = 1e-10 * std::max(1.0, tmax); // resolution of the flow time
+
+    // output times in (tstart, tmax], in increasing order
+    std::vector<double> t_out;
+    if (measure_times.empty()) {
+      for (double tk = tstart + eps; tk <= tmax + t_eps; tk += 2 * eps) {
+        t_out.push_back(tk);
       }
+    } else {
+      for (size_t k = 0; k < measure_times.size(); k++) {
+        if (measure_times[k] > tstart + t_eps && measure_times[k] <= tmax + t_eps) {
+          t_out.push_back(measure_times[k]);
+        }
+      }
+      std::sort(t_out.begin(), t_out.end());
+    }
 
-      const double tsqr = t[1] * t[1];
+    std::ostringstream oss;
+    clover_field<Group> G;
 
-      const double Ep = ndims_fact - P[1];
-      const double Ep_ss = ndims_fact_ss - P_ss[1];
+    gaugeconfig<Group> Vt(U);
+    adjointfield<double, Group> deriv(U.getLx(), U.getLy(), U.getLz(), U.getLt(), d);
+    hamiltonian_field<double, Group> h(deriv, Vt);
+    gaugemonomial<double, Group> SW(0, xi); // Wilson (pure) gauge action
+    // field before the step and workspace of the error estimate
+    gaugeconfig<Group> W0(U);
+    adjointfield<double, Group> A(U.getLx(), U.getLy(), U.getLz(), U.getLt(), d);
 
-      const double Ep_ts = Ep - Ep_ss;
+    if (tstart == 0.0) {
+      print_flow_header(oss);
+    }
 
-      const double Ep_ts_bar = Ep_ts / (d - 1);
-      const double Ep_ss_bar = Ep_ss / ndims_fact_ss;
+    double t = tstart, h_eps = (st.eps > 0.0) ? st.eps : eps;
+    size_t n_acc = 0, n_rej = 0, k_out = 0;
+
+    // last (up to) three consecutive accepted points where the observables are known
+    // (st.ts, st.obs). A step can at most double the next one, hence after the point t
+    // the flow reaches at most t + 3*h_eps within two steps and the observables are
+    // needed only if the next output time, or tmax for the checkpoint, is closer.
+    auto add_point = [&]() {
+      const double t_reach = t + 3.0 * h_eps + t_eps;
+      if (!((k_out < t_out.size() && t_out[k_out] <= t_reach) || tmax <= t_reach)) {
+        st.ts.clear();
+        st.obs.clear();
+        return;
+      }
+      st.add_point(t, G.observables(Vt));
+    };
+    if (st.ts.empty() || st.ts.back() != tstart) {
+      st.ts.clear();
+      st.obs.clear();
+      add_point();
+    }
 
-      const double xi2_R = Ep_ts_bar / Ep_ss_bar;
-      const double xi_R = sqrt(xi2_R);
+    while (t < tmax - t_eps) {
+      const double dt = std::min(h_eps, tmax - t);
+      const double err = runge_kutta(h, SW, dt, &W0, &A);
+      if (!(err == err)) {
+        spacetime_lattice::fatal_error("Invalid error estimate of the flow.", __func__);
+      }
+      const double h_prev = h_eps;
+      h_eps = dt * std::min(2.0, std::max(0.2, 0.95 * std::cbrt(tolerance / err)));
+      if (dt < h_prev && err <= tolerance) {
+        h_eps = std::max(h_eps, h_prev); // the step was shortened to reach tmax
+      }
+      if (err > tolerance) {
+        Vt = W0; // reject: start again from the previous field
+        n_rej++;
+        if (h_eps < t_eps) {
+          spacetime_lattice::fatal_error("Step size of the flow below resolution.",
+                                         __func__);
+        }
+        continue;
+      }
+      n_acc++;
+      t += dt;
+      add_point();
 
-      const double t2Ep = tsqr * Ep;
-      const double t2Ep_ss = tsqr * Ep_ss;
-      const double t2Ep_ts = tsqr * Ep_ts;
+      for (; k_out < t_out.size() && t_out[k_out] <= t + t_eps; k_out++) {
+        print_flow_observables(
+          oss, Vt, t_out[k_out], interpolate_flow_observables(st.ts, st.obs, t_out[k_out]));
+      }
+    }
+    std::cout << "## gradient flow: " << n_acc << " accepted and " << n_rej
+              << " rejected steps\n";
+    st.t = t;
+    st.eps = h_eps;
+    st.n_steps += n_acc;
 
-      const double Ec = E[1];
-      const double Ec_ss = E_ss[1];
-      const double Ec_ts = Ec - Ec_ss;
+    write_flow_output(path, oss.str(), tstart, save_config, Vt, st);
+    if (state != nullptr) {
+      *state = st;
+    }
+    return;
+  }
 
-      const double t2Ec = tsqr * Ec;
-      const double t2Ec_ss = tsqr * Ec_ss;
+  /**
+   * @brief flow scales of a configuration, NAN if not reached
+   */
+  struct flow_scales {
+    double t0 = NAN; // t^2 E(t) = t0_ref at t = t0
+    double w0 = NAN; // t d/dt(t^2 E(t)) = w0_ref at t = w0^2
+    double tstop = 0.; // flow time at the end of the flow
+  };
 
-      oss << std::scientific; // using scientific notation
-      oss.precision(16);
-      oss << t[1] << " ";
-      oss << xi_R << " ";
-      oss << P[1] << " " << P_ss[1] << " ";
-      oss << Ep << " " << Ep_ss << " ";
-      oss << Ec << " " << Ec_ss << " ";
-      oss << Q[1] << "\n";
+  /**
+   * @brief root of f in [a, b] by bisection, f(a) < 0 <= f(b)
+   */
+  template <class Function> double bisect(const Function &f, double a, double b) {
+    for (size_t k = 0; k < 60 && b - a > 1e-14 * b; k++) {
+      const double c = 0.5 * (a + b);
+      if (f(c) < 0.0) {
+        a = c;
+      } else {
+        b = c;
+      }
     }
+    return 0.5 * (a + b);
+  }
+
+  /**
+   * @brief gradient flow for the scale setting with t0 and w0
+   * The flow is integrated with step eps as in gradient_flow(), with the same output on
+   * 'path'. E is the clover energy density (column Ec). After each step, the quadratic
+   * interpolation of F(t) = t^2 E(t) through the last three flow times gives F(t) and
+   * W(t) = t dF/dt between the last two, and the first crossings F = t0_ref and
+   * W = w0_ref from below are located by bisection. The flow stops as soon as both are
+   * found and t is beyond the later of t0 and w0^2 by margin, at the latest at tmax.
+   * @param t0_ref value of t^2 E at t0
+   * @param w0_ref value of t d/dt(t^2 E) at w0^2
+   * @param margin flow time after the crossings before stopping
+   * @param state if given, state of the flow at tstart on entry (the scales found and
+   * the last points are reused) and at the end on return
+   * @return t0, w0 and the flow time where the flow stopped
+   */
+  template <class Group>
+  flow_scales gradient_flow_scale(const gaugeconfig<Group> &U,
+                                  std::string const &path,
+                                  const double &tmax,
+                                  const double &eps,
+                                  const double &xi,
+                                  const double &tstart,
+                                  const bool &save_config,
+                                  const double &t0_ref,
+                                  const double &w0_ref,
+                                  const double &margin,
+                                  flow_state *state = nullptr) {
+    const size_t d = U.getndims();
+    flow_state st = (state != nullptr) ? *state : flow_state();
+
+    std::ostringstream oss;
+    clover_field<Group> G;
+
+    gaugeconfig<Group> Vt(U);
+    adjointfield<double, Group> deriv(U.getLx(), U.getLy(), U.getLz(), U.getLt(), d);
+    hamiltonian_field<double, Group> h(deriv, Vt);
+    gaugemonomial<double, Group> SW(0, xi); // Wilson (pure) gauge action
 
-    std::ofstream ofs;
     if (tstart == 0.0) {
-      ofs.open(path, std::ios::out);
-    } else {
-      ofs.open(path, std::ios::app);
+      print_flow_header(oss);
     }
 
-    ofs << oss.str();
-    if (save_config) {
-      Vt.save(path + "_t" + std::to_string(tmax) + ".conf");
+    // t^2 E(t) at the last three flow times
+    if (st.ts.empty() || st.ts.back() != tstart) {
+      st.ts.clear();
+      st.obs.clear();
+      st.add_point(tstart, G.observables(Vt));
+    }
+    std::vector<double> ts = st.ts;
+    std::vector<double> F;
+    for (size_t k = 0; k < ts.size(); k++) {
+      F.push_back(ts[k] * ts[k] * st.obs[k].E);
     }
+    auto F_interp = [&](const double &t) {
+      const std::vector<double> w = lagrange_weights(ts, t);
+      return w[0] * F[0] + w[1] * F[1] + w[2] * F[2] - t0_ref;
+    };
+    auto W_interp = [&](const double &t) {
+      const std::vector<double> w = lagrange_derivative_weights(ts, t);
+      return t * (w[0] * F[0] + w[1] * F[1] + w[2] * F[2]) - w0_ref;
+    };
 
-    return;
+    flow_scales res;
+    res.t0 = st.t0;
+    res.w0 = st.w0;
+    double t = tstart;
+    while (t < tmax - eps / 2.0) {
+      runge_kutta(h, SW, eps);
+      t += eps;
+      st.n_steps++;
+      const clover_observables obs = G.observables(Vt);
+      if (st.n_steps % 2 == 1) {
+        print_flow_observables(oss, Vt, t, obs);
+      }
+      st.add_point(t, obs);
+
+      if (ts.size() == 3) {
+        ts.erase(ts.begin());
+        F.erase(F.begin());
+      }
+      ts.push_back(t);
+      F.push_back(t * t * obs.E);
+      if (ts.size() < 3) {
+        continue;
+      }
+
+      if (std::isnan(res.t0) && F_interp(ts[1]) < 0.0 && F_interp(ts[2]) >= 0.0) {
+        res.t0 = bisect(F_interp, ts[1], ts[2]);
+      }
+      if (std::isnan(res.w0) && W_interp(ts[1]) < 0.0 && W_interp(ts[2]) >= 0.0) {
+        res.w0 = std::sqrt(bisect(W_interp, ts[1], ts[2]));
+      }
+      if (!std::isnan(res.t0) && !std::isnan(res.w0) &&
+          t >= std::max(res.t0, res.w0 * res.w0) + margin) {
+        break;
+      }
+    }
+    res.tstop = t;
+    st.t = t;
+    st.eps = eps;
+    st.t0 = res.t0;
+    st.w0 = res.w0;
+
+    write_flow_output(path, oss.str(), tstart, save_config, Vt, st);
+    if (state != nullptr) {
+      *state = st;
+    }
+    return res;
   }
 
 } // namespace flat_spacetime
@@ -26,6 +26,43 @@
 
 namespace flat_spacetime {
 
+  /**
+   * @brief N_hit Metropolis updates of the single link U_mu(x) (see sweep())
+   * The staples are computed once, the links around U_mu(x) do not change.
+   * @return number of accepted updates
+   */
+  template <class URNG, class Group>
+  size_t metropolis_link(gaugeconfig<Group> &U,
+                         const std::vector<size_t> &x,
+                         const size_t &mu,
+                         URNG &engine,
+                         const double &delta,
+                         const size_t &N_hit,
+                         const double &beta,
+                         const double &xi = 1.0,
+                         const bool &anisotropic = false) {
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    typedef typename accum_type<Group>::type accum;
+    size_t rate = 0;
+    Group R;
+    accum K;
+    get_staples(K, U, x, mu, xi, anisotropic);
+    for (size_t n = 0; n < N_hit; n++) {
+      random_element(R, engine, delta);
+      double deltaS = beta / static_cast<double>(U.getNc()) *
+                      (retrace(U(x, mu) * K) - retrace(U(x, mu) * R * K));
+      bool accept = (deltaS < 0);
+      if (!accept)
+        accept = (uniform(engine) < exp(-deltaS));
+      if (accept) {
+        U(x, mu) = U(x, mu) * R;
+        U(x, mu).restoreSU();
+        rate += 1;
+      }
+    }
+    return rate;
+  }
+
   /**
    * @brief N_hit Metropolis-Updates
    * does N_hit Metropolis updates of every link (U -> R*U, where R is a random element):
@@ -69,8 +106,6 @@ namespace flat_spacetime {
                             const double &beta,
                             const double &xi = 1.0,
                             const bool &anisotropic = false) {
-    std::uniform_real_distribution<double> uniform(0., 1.);
-    typedef typename accum_type<Group>::type accum;
     size_t rate = 0, rate_time = 0;
 #ifdef _USE_OMP_
 #pragma omp parallel
@@ -95,29 +130,16 @@ namespace flat_spacetime {
          * This is not the case here, but in an example the code compiled anyway.
          */
 
-        Group R;
         for (size_t x1 = 0; x1 < U.getLx(); x1++) {
           for (size_t x2 = 0; x2 < U.getLy(); x2++) {
             for (size_t x3 = 0; x3 < U.getLz(); x3++) {
               std::vector<size_t> x = {x0, x1, x2, x3};
               for (size_t mu = 0; mu < U.getndims(); mu++) {
-                accum K;
-                get_staples(K, U, x, mu, xi, anisotropic);
-                for (size_t n = 0; n < N_hit; n++) {
-                  random_element(R, engine[thread_num], delta);
-                  double deltaS = beta / static_cast<double>(U.getNc()) *
-                                  (retrace(U(x, mu) * K) - retrace(U(x, mu) * R * K));
-                  bool accept = (deltaS < 0);
-                  if (!accept)
-                    accept = (uniform(engine[thread_num]) < exp(-deltaS));
-                  if (accept) {
-                    U(x, mu) = U(x, mu) * R;
-                    U(x, mu).restoreSU();
-                    rate += 1;
-                    if (mu == 0) {
-                      rate_time += 1;
-                    }
-                  }
+                const size_t acc = metropolis_link(U, x, mu, engine[thread_num], delta,
+                                                   N_hit, beta, xi, anisotropic);
+                rate += acc;
+                if (mu == 0) {
+                  rate_time += acc;
                 }
               }
             }
@@ -126,29 +148,16 @@ namespace flat_spacetime {
       }
 #pragma omp for reduction(+ : rate, rate_time)
       for (size_t x0 = 1; x0 < U.getLt(); x0 += 2) {
-        Group R;
         for (size_t x1 = 0; x1 < U.getLx(); x1++) {
           for (size_t x2 = 0; x2 < U.getLy(); x2++) {
             for (size_t x3 = 0; x3 < U.getLz(); x3++) {
               std::vector<size_t> x = {x0, x1, x2, x3};
               for (size_t mu = 0; mu < U.getndims(); mu++) {
-                accum K;
-                get_staples(K, U, x, mu, xi, anisotropic);
-                for (size_t n = 0; n < N_hit; n++) {
-                  random_element(R, engine[thread_num], delta);
-                  double deltaS = beta / static_cast<double>(U.getNc()) *
-                                  (retrace(U(x, mu) * K) - retrace(U(x, mu) * R * K));
-                  bool accept = (deltaS < 0);
-                  if (!accept)
-                    accept = (uniform(engine[thread_num]) < exp(-deltaS));
-                  if (accept) {
-                    U(x, mu) = U(x, mu) * R;
-                    U(x, mu).restoreSU();
-                    rate += 1;
-                    if (mu == 0) {
-                      rate_time += 1;
-                    }
-                  }
+                const size_t acc = metropolis_link(U, x, mu, engine[thread_num], delta,
+                                                   N_hit, beta, xi, anisotropic);
+                rate += acc;
+                if (mu == 0) {
+                  rate_time += acc;
                 }
               }
             }
@@ -158,6 +167,7 @@ namespace flat_spacetime {
 #ifdef _USE_OMP_
     }
 #endif
+    U.touch();
     std::vector<double> res = {double(rate) / double(N_hit) / double(U.getSize()),
                                double(rate_time) / double(N_hit) / double(U.getVolume())};
     return res;
@@ -253,9 +263,52 @@ namespace flat_spacetime {
 #ifdef _USE_OMP_
     }
 #endif
+    U.touch();
     std::vector<double> res = {double(rate) / double(N_hit) / double(U.getSize()),
                                double(rate_time) / double(N_hit) / double(U.getVolume())};
     return res;
   }
 
+  /**
+   * @brief N_hit Metropolis updates of the links inside one time slab
+   * The slab consists of the time slices t0, ..., t0+thickness-1. Updated are the
+   * temporal links on these time slices and the spatial links on t0+1, ...,
+   * t0+thickness-1, while the spatial links on the time slices t0 and t0+thickness,
+   * the boundaries of the slab, stay fixed. No link outside the slab or its boundaries
+   * is read, so with frozen boundaries different slabs are independent and can be
+   * updated concurrently (see multilevel.hh). The links are visited sequentially,
+   * U.touch() is left to the caller.
+   * @return acceptance rate
+   */
+  template <class URNG, class Group>
+  double slab_sweep(gaugeconfig<Group> &U,
+                    URNG &engine,
+                    const size_t &t0,
+                    const size_t &thickness,
+                    const double &delta,
+                    const size_t &N_hit,
+                    const double &beta,
+                    const double &xi = 1.0,
+                    const bool &anisotropic = false) {
+    size_t rate = 0, n_links = 0;
+    for (size_t k = 0; k < thickness; k++) {
+      const size_t x0 = (t0 + k) % U.getLt();
+      for (size_t x1 = 0; x1 < U.getLx(); x1++) {
+        for (size_t x2 = 0; x2 < U.getLy(); x2++) {
+          for (size_t x3 = 0; x3 < U.getLz(); x3++) {
+            std::vector<size_t> x = {x0, x1, x2, x3};
+            // spatial links on the lower boundary are frozen
+            const size_t mu_max = (k == 0) ? 1 : U.getndims();
+            for (size_t mu = 0; mu < mu_max; mu++) {
+              rate +=
+                metropolis_link(U, x, mu, engine, delta, N_hit, beta, xi, anisotropic);
+              n_links++;
+            }
+          }
+        }
+      }
+    }
+    return double(rate) / double(N_hit) / double(n_links);
+  }
+
 } // namespace flat_spacetime
@@ -0,0 +1,203 @@
+/**
+ * @file flow_checkpoint.hh
+ * @brief state of the gradient flow of a configuration and its checkpoint file
+ *
+ * A checkpoint holds everything needed to continue the flow where it stopped: the
+ * flowed field, the flow time, the state of the integrator and the observables at the
+ * last (up to) three flow times, which the adaptive integration and the scale setting
+ * need for the interpolation. The file starts with a small header (format tag, lattice
+ * size, size of a link, fingerprint of the unflowed configuration), such that a
+ * checkpoint of a different lattice, gauge group or configuration is recognised and
+ * ignored.
+ */
+
+#pragma once
+
+#include "clover_field.hh"
+#include "gaugeconfig.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace flat_spacetime {
+
+  /**
+   * @brief state of the gradient flow after the last step
+   */
+  struct flow_state {
+    double t = 0.; // flow time of the field
+    double eps = 0.; // step size for the next step (0: not known)
+    uint64_t n_steps = 0; // number of integration steps from t = 0
+    double t0 = NAN, w0 = NAN; // scales found so far (see gradient_flow_scale())
+    uint64_t origin = 0; // fingerprint of the unflowed configuration
+    std::vector<double> ts; // last (up to) three flow times, ts.back() == t
+    std::vector<clover_observables> obs; // observables at the flow times ts
+
+    // keep the last three points of the flow
+    void add_point(const double &tk, const clover_observables &ok) {
+      if (ts.size() == 3) {
+        ts.erase(ts.begin());
+        obs.erase(obs.begin());
+      }
+      ts.push_back(tk);
+      obs.push_back(ok);
+    }
+  };
+
+  namespace flow_checkpoint {
+
+    const char tag[8] = {'S', 'U', '2', 'F', 'L', 'O', 'W', '2'};
+
+    template <class Group>
+    std::vector<uint64_t> header(const gaugeconfig<Group> &V, const uint64_t &origin) {
+      return {V.getLx(),    V.getLy(),     V.getLz(), V.getLt(),
+              V.getndims(), sizeof(Group), origin};
+    }
+
+    /**
+     * @brief fingerprint of the configuration U with index i
+     * 64 bit FNV-1a hash of the bytes of the links and of i.
+     */
+    template <class Group>
+    uint64_t fingerprint(const gaugeconfig<Group> &U, const uint64_t &i) {
+      uint64_t h = 14695981039346656037ULL;
+      auto add = [&](const unsigned char *p, const size_t &n) {
+        for (size_t k = 0; k < n; k++) {
+          h = (h ^ p[k]) * 1099511628211ULL;
+        }
+      };
+      for (size_t j = 0; j < U.getSize(); j++) {
+        const Group l = U[j];
+        add(reinterpret_cast<const unsigned char *>(&l), sizeof(Group));
+      }
+      add(reinterpret_cast<const unsigned char *>(&i), sizeof(i));
+      return h;
+    }
+
+  } // namespace flow_checkpoint
+
+  /**
+   * @brief write the flowed field V and the state of the flow to path
+   * The file is written under a temporary name and then renamed, such that an
+   * interrupted write does not destroy the previous checkpoint.
+   */
+  template <class Group>
+  void save_flow_checkpoint(const std::string &path,
+                            const gaugeconfig<Group> &V,
+                            const flow_state &state) {
+    const std::string tmp = path + ".tmp";
+    std::ofstream ofs(tmp, std::ios::out | std::ios::binary);
+    auto write = [&](const void *p, const size_t &n) {
+      ofs.write(reinterpret_cast<char const *>(p), n);
+    };
+
+    const std::vector<uint64_t> h = flow_checkpoint::header(V, state.origin);
+    write(flow_checkpoint::tag, sizeof(flow_checkpoint::tag));
+    write(h.data(), h.size() * sizeof(uint64_t));
+
+    write(&state.t, sizeof(double));
+    write(&state.eps, sizeof(double));
+    write(&state.n_steps, sizeof(uint64_t));
+    write(&state.t0, sizeof(double));
+    write(&state.w0, sizeof(double));
+    const uint64_t n_points = state.ts.size();
+    write(&n_points, sizeof(uint64_t));
+    for (size_t k = 0; k < n_points; k++) {
+      const double p[6] = {state.ts[k],    state.obs[k].P,    state.obs[k].P_ss,
+                           state.obs[k].E, state.obs[k].E_ss, state.obs[k].Q};
+      write(p, sizeof(p));
+    }
+
+    std::vector<Group> links(V.getSize());
+    for (size_t i = 0; i < links.size(); i++) {
+      links[i] = V[i];
+    }
+    write(links.data(), links.size() * sizeof(Group));
+    ofs.close();
+    if (!ofs) {
+      spacetime_lattice::fatal_error("Cannot write the flow checkpoint " + path, __func__);
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+      spacetime_lattice::fatal_error("Cannot rename " + tmp + " to " + path, __func__);
+    }
+    return;
+  }
+
+  /**
+   * @brief read the flowed field and the state of the flow from path
+   * V must have the size of the lattice, origin is the fingerprint of the configuration
+   * the flow has to start from (see flow_checkpoint::fingerprint()).
+   * @return false (V and state unchanged) if the file does not exist or belongs to a
+   * different lattice, gauge group or configuration
+   */
+  template <class Group>
+  bool load_flow_checkpoint(const std::string &path,
+                            gaugeconfig<Group> &V,
+                            flow_state &state,
+                            const uint64_t &origin) {
+    std::ifstream ifs(path, std::ios::in | std::ios::binary);
+    if (!ifs) {
+      return false;
+    }
+    auto read = [&](void *p, const size_t &n) {
+      ifs.read(reinterpret_cast<char *>(p), n);
+    };
+
+    char tag[sizeof(flow_checkpoint::tag)];
+    read(tag, sizeof(tag));
+    const std::vector<uint64_t> h0 = flow_checkpoint::header(V, origin);
+    std::vector<uint64_t> h(h0.size());
+    read(h.data(), h.size() * sizeof(uint64_t));
+    if (!ifs || !std::equal(tag, tag + sizeof(tag), flow_checkpoint::tag) ||
+        !std::equal(h0.begin(), h0.end() - 1, h.begin())) {
+      std::cerr << "## Warning: ignoring the incompatible flow checkpoint " << path
+                << std::endl;
+      return false;
+    }
+    if (h.back() != origin) {
+      std::cerr << "## Warning: ignoring the flow checkpoint " << path
+                << " of a different configuration, the flow starts again" << std::endl;
+      return false;
+    }
+
+    flow_state s;
+    s.origin = origin;
+    read(&s.t, sizeof(double));
+    read(&s.eps, sizeof(double));
+    read(&s.n_steps, sizeof(uint64_t));
+    read(&s.t0, sizeof(double));
+    read(&s.w0, sizeof(double));
+    uint64_t n_points = 0;
+    read(&n_points, sizeof(uint64_t));
+    for (size_t k = 0; k < n_points && k < 3; k++) {
+      double p[6];
+      read(p, sizeof(p));
+      clover_observables o;
+      o.P = p[1];
+      o.P_ss = p[2];
+      o.E = p[3];
+      o.E_ss = p[4];
+      o.Q = p[5];
+      s.add_point(p[0], o);
+    }
+
+    gaugeconfig<Group> W(V);
+    read(&W[0], W.storage_size());
+    if (!ifs || n_points > 3) {
+      std::cerr << "## Warning: ignoring the corrupted flow checkpoint " << path
+                << std::endl;
+      return false;
+    }
+    W.touch();
+    V = W;
+    state = s;
+    return true;
+  }
+
+} // namespace flat_spacetime
@@ -12,12 +12,14 @@
 
 #pragma once
 
+#include "counter_rng.hh"
 #include "geometry.hh"
 #include "random_element.hh"
 #include "su2.hh"
 #include "u1.hh"
 
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <complex>
@@ -37,13 +39,23 @@ template <> std::string gauge_group_name<_su2>() {
 
 using std::vector;
 
+/**
+ * @brief new revision stamp for the links of a gauge configuration
+ * The stamps are unique in the whole program, such that a stamp identifies one state
+ * of the links of one configuration (see gaugeconfig::touch()).
+ */
+inline size_t next_gauge_revision() {
+  static std::atomic<size_t> counter(0);
+  return ++counter;
+}
+
 template <class T> class gaugeconfig {
   template <class iT> using nd_max_arr = spacetime_lattice::nd_max_arr<iT>;
 
 public:
   using value_type = T;
 
-  gaugeconfig(){};
+  gaugeconfig() : revision(next_gauge_revision()){};
   ~gaugeconfig(){};
 
   gaugeconfig(const size_t Lx,
@@ -58,7 +70,8 @@ public:
       Lt(Lt),
       volume(Lx * Ly * Lz * Lt),
       beta(beta),
-      ndims(ndims) {
+      ndims(ndims),
+      revision(next_gauge_revision()) {
     data.resize(volume * ndims);
   }
   gaugeconfig(const gaugeconfig &U)
@@ -68,7 +81,8 @@ public:
       Lt(U.getLt()),
       volume(U.getVolume()),
       beta(U.getBeta()),
-      ndims(U.getndims()) {
+      ndims(U.getndims()),
+      revision(U.getRevision()) {
     data.resize(volume * ndims);
 #pragma omp parallel for
     for (size_t i = 0; i < getSize(); i++) {
@@ -117,6 +131,22 @@ public:
     for (size_t i = 0; i < getSize(); i++) {
       data[i].restoreSU();
     }
+    touch();
+  }
+
+  /**
+   * @brief revision stamp of the links
+   * Fields derived from the links (e.g. the plaquettes, see plaquette_field.hh) are
+   * cached together with the stamp of the configuration they were computed from.
+   * Copies share the stamp of the original, and every function changing the links
+   * gets a new one by calling touch(). Code writing links through operator[] or
+   * operator() has to call touch() afterwards.
+   */
+  size_t getRevision() const {
+    return revision;
+  }
+  void touch() {
+    revision = next_gauge_revision();
   }
 
   void operator=(const gaugeconfig &U) {
@@ -132,6 +162,22 @@ public:
     for (size_t i = 0; i < U.getSize(); i++) {
       data[i] = U[i];
     }
+    revision = U.getRevision();
+  }
+
+  /**
+   * @brief exchange the content with U in O(1), without copying the links
+   */
+  void swap(gaugeconfig &U) {
+    std::swap(volume, U.volume);
+    std::swap(Lx, U.Lx);
+    std::swap(Ly, U.Ly);
+    std::swap(Lz, U.Lz);
+    std::swap(Lt, U.Lt);
+    std::swap(ndims, U.ndims);
+    std::swap(beta, U.beta);
+    std::swap(revision, U.revision);
+    data.swap(U.data);
   }
 
   value_type &operator()(
@@ -205,6 +251,7 @@ public:
 private:
   size_t Lx, Ly, Lz, Lt, volume, ndims;
   double beta;
+  size_t revision; // see getRevision()
 
   std::vector<value_type> data;
 
@@ -244,6 +291,7 @@ template <class T> int gaugeconfig<T>::load(std::string const &path) {
   if (ifs) {
     ifs.read(reinterpret_cast<char *>(data.data()), storage_size());
     ifs.close();
+    touch();
     return 0;
   } else {
     std::cerr << "Error: could not read file from " << path << std::endl;
@@ -256,6 +304,7 @@ template <class T> void coldstart(gaugeconfig<T> &config) {
   for (size_t i = 0; i < config.getSize(); i++) {
     config[i] = T(1., 0.);
   }
+  config.touch();
 }
 
 template <class T> void coldstart(gaugeconfig<_u1> &config) {
@@ -263,6 +312,7 @@ template <class T> void coldstart(gaugeconfig<_u1> &config) {
   for (size_t i = 0; i < config.getSize(); i++) {
     config[i] = _u1(0.);
   }
+  config.touch();
 }
 
 /**
@@ -281,11 +331,13 @@ void hotstart(gaugeconfig<T> &config, const int seed, const double _delta) {
     delta = 0;
   if (delta > 1.)
     delta = 1.;
-  std::mt19937 engine(seed);
-
+  // one counter-based stream per link: thread-count independent
+#pragma omp parallel for
   for (size_t i = 0; i < config.getSize(); i++) {
+    counter_rng::philox_engine engine(seed, i);
     random_element(config[i], engine, delta);
   }
+  config.touch();
 }
 
 /**
@@ -294,9 +346,5 @@ void hotstart(gaugeconfig<T> &config, const int seed, const double _delta) {
  */
 template <class T>
 void hotstart(gaugeconfig<T> &config, const int seed, const bool &hot) {
-  const double delta = (double)hot;
-  std::mt19937 engine(seed);
-  for (size_t i = 0; i < config.getSize(); i++) {
-    random_element(config[i], engine, delta);
-  }
+  hotstart(config, seed, (double)hot);
 }
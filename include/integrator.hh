@@ -11,6 +11,7 @@
 #include<iostream>
 #include<cmath>
 #include<map>
+#include<memory>
 
 enum integrators { LEAPFROG = 0, LP_LEAPFROG = 1, OMF4 = 2, LP_OMF4 = 3, EULER = 4, RUTH = 5, OMF2 = 6};
 
@@ -18,8 +19,20 @@ enum integrators { LEAPFROG = 0, LP_LEAPFROG = 1, OMF4 = 2, LP_OMF4 = 3, EULER =
 template<typename Float, class Group> class integrator{
 public:
   integrator() {}
+  virtual ~integrator() {}
   virtual void integrate(std::list<monomial<Float, Group>*> &monomial_list, hamiltonian_field<Float, Group> &h, 
                          md_params const &params, const bool restore = true) = 0;
+protected:
+  // buffer for the derivatives, allocated at the first call of integrate()
+  // and reused by the following trajectories
+  adjointfield<Float, Group> &get_deriv_buffer(hamiltonian_field<Float, Group> const &h) {
+    if(!deriv || deriv->getSize() != h.momenta->getSize()) {
+      deriv.reset(new adjointfield<Float, Group>(h.U->getLx(), h.U->getLy(), h.U->getLz(), h.U->getLt(), h.U->getndims()));
+    }
+    return *deriv;
+  }
+private:
+  std::unique_ptr<adjointfield<Float, Group>> deriv;
 };
 
 // leapfrog integration scheme
@@ -29,23 +42,21 @@ public:
   void integrate(std::list<monomial<Float, Group>*> &monomial_list, hamiltonian_field<Float, Group> &h, 
                  md_params const &params, const bool restore=true) {
 
-    adjointfield<Float, Group> deriv(h.U->getLx(), h.U->getLy(), h.U->getLz(), h.U->getLt(), h.U->getndims());
+    adjointfield<Float, Group> &deriv = this->get_deriv_buffer(h);
     
     Float dtau = params.gettau()/Float(params.getnsteps());
     // initial half-step for the  momenta
     update_momenta(monomial_list, deriv, h, dtau/2.);
     // first full step for gauge
-    update_gauge(h, dtau);
-    // nsteps-1 full steps
+    update_gauge(h, dtau, restore && (params.getnsteps() == 1));
+    // nsteps-1 full steps, the last gauge update restores SU in the same pass
     for(size_t i = 0; i < params.getnsteps()-1; i++) {
       update_momenta(monomial_list, deriv, h, dtau);
-      update_gauge(h, dtau);
+      update_gauge(h, dtau, restore && (i == params.getnsteps()-2));
     }
 
     // final half-step for the momenta
     update_momenta(monomial_list, deriv, h, dtau/2.);
-    // restore SU
-    if(restore) h.U->restoreSU();
   }
 };
 
@@ -56,7 +67,7 @@ public:
   lp_leapfrog(size_t n) : n_prec(n) {}
   void integrate(std::list<monomial<Float, Group>*> &monomial_list, hamiltonian_field<Float, Group> &h, 
                  md_params const &params, const bool restore = true) {
-    adjointfield<Float, Group> deriv(h.U->getLx(), h.U->getLy(), h.U->getLz(), h.U->getLt(), h.U->getndims());
+    adjointfield<Float, Group> &deriv = this->get_deriv_buffer(h);
     const size_t N = pow(10, n_prec);
 
     Float dtau = params.gettau()/Float(params.getnsteps());
@@ -83,10 +94,12 @@ private:
 template<typename Float, class Group> class omf2 : public integrator<Float, Group> {
 public:
   omf2() : lambda(0.1938) {}
+  omf2(const double _lambda) : lambda(_lambda) {}
+  double getlambda() const { return lambda; }
   void integrate(std::list<monomial<Float, Group>*> &monomial_list, hamiltonian_field<Float, Group> &h, 
                  md_params const &params, const bool restore = true) {
 
-    adjointfield<Float, Group> deriv(h.U->getLx(), h.U->getLy(), h.U->getLz(), h.U->getLt(), h.U->getndims());
+    adjointfield<Float, Group> &deriv = this->get_deriv_buffer(h);
     Float dtau = params.gettau()/Float(params.getnsteps());
     Float oneminus2lambda = (1.-2.*lambda);
 
@@ -104,11 +117,9 @@ public:
     // almost one more full step
     update_gauge(h, 0.5*dtau);
     update_momenta(monomial_list, deriv, h, oneminus2lambda*dtau);
-    update_gauge(h, 0.5*dtau);
+    update_gauge(h, 0.5*dtau, restore);
     // final step in the momenta
     update_momenta(monomial_list, deriv, h, lambda*dtau);
-    // restore SU
-    if(restore) h.U->restoreSU();
   }
 private:
   double lambda;
@@ -122,7 +133,7 @@ public:
   void integrate(std::list<monomial<Float, Group>*> &monomial_list, hamiltonian_field<Float, Group> &h, 
                  md_params const &params, const bool restore = true) {
 
-    adjointfield<Float, Group> deriv(h.U->getLx(), h.U->getLy(), h.U->getLz(), h.U->getLt(), h.U->getndims());
+    adjointfield<Float, Group> &deriv = this->get_deriv_buffer(h);
     Float dtau = params.gettau()/Float(params.getnsteps());
     Float eps[10] = {rho*dtau, lambda*dtau, 
                  theta*dtau, 0.5*(1-2.*(lambda+vartheta))*dtau, 
@@ -144,11 +155,9 @@ public:
       update_gauge(h, eps[2*j]);
       update_momenta(monomial_list, deriv, h, eps[2*j+1]);
     }
-    update_gauge(h, eps[8]);
+    update_gauge(h, eps[8], restore);
     // final half-step in the momenta
     update_momenta(monomial_list, deriv, h, 0.5*eps[9]);
-    // restore SU
-    if(restore) h.U->restoreSU();
   }
 private:
   double rho, theta, vartheta, lambda;
@@ -162,7 +171,7 @@ public:
   void integrate(std::list<monomial<Float, Group>*> &monomial_list, hamiltonian_field<Float, Group> &h, 
                  md_params const &params, const bool restore = true) {
 
-    adjointfield<Float, Group> deriv(h.U->getLx(), h.U->getLy(), h.U->getLz(), h.U->getLt(), h.U->getndims());
+    adjointfield<Float, Group> &deriv = this->get_deriv_buffer(h);
     const size_t N = pow(10, n_prec);
 
     Float dtau = params.gettau()/Float(params.getnsteps());
@@ -204,15 +213,13 @@ public:
   void integrate(std::list<monomial<Float, Group>*> &monomial_list, hamiltonian_field<Float, Group> &h, 
                  md_params const &params, const bool restore = true) {
 
-    adjointfield<Float, Group> deriv(h.U->getLx(), h.U->getLy(), h.U->getLz(), h.U->getLt(), h.U->getndims());
+    adjointfield<Float, Group> &deriv = this->get_deriv_buffer(h);
     Float dtau = params.gettau()/Float(params.getnsteps());
     // nsteps full steps
     for(size_t i = 0; i < params.getnsteps(); i++) {
       update_momenta(monomial_list, deriv, h, dtau);
-      update_gauge(h, dtau);
+      update_gauge(h, dtau, restore && (i == params.getnsteps()-1));
     }
-    // restore SU
-    if(restore) h.U->restoreSU();
   }
 };
 
@@ -223,7 +230,7 @@ public:
   void integrate(std::list<monomial<Float, Group>*> &monomial_list, hamiltonian_field<Float, Group> &h, 
                  md_params const &params, const bool restore = true) {
 
-    adjointfield<Float, Group> deriv(h.U->getLx(), h.U->getLy(), h.U->getLz(), h.U->getLt(), h.U->getndims());
+    adjointfield<Float, Group> &deriv = this->get_deriv_buffer(h);
     
     Float dtau = params.gettau()/Float(params.getnsteps());
     // nsteps full steps
@@ -233,10 +240,8 @@ public:
       update_momenta(monomial_list, deriv, h, -2./3.*dtau);
       update_gauge(h, 3./4.*dtau);
       update_momenta(monomial_list, deriv, h, 2./3.*dtau);
-      update_gauge(h, 7./24.*dtau);
+      update_gauge(h, 7./24.*dtau, restore && (i == params.getnsteps()-1));
     }
-    // restore SU
-    if(restore) h.U->restoreSU();
   }
 };
 
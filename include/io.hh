@@ -222,15 +222,15 @@ namespace io {
       std::ofstream resultfile;
       size_t maxsizenonplanar = (pparams.Lx < 4) ? pparams.Lx : 4;
 
-      if (pparams.ndims == 2 || pparams.ndims == 4) {
-        std::cerr << "Currently not working for dim = 2 and dim = 4, no nonplanar "
+      if (pparams.ndims == 2) {
+        std::cerr << "Currently not working for dim = 2, no nonplanar "
                      "measurements will be made"
                   << std::endl;
         mparams.potentialnonplanar = false;
       }
 
       //~ print heads of columns
-      if (!mparams.append && (pparams.ndims == 3)) {
+      if (!mparams.append && (pparams.ndims == 3 || pparams.ndims == 4)) {
         resultfile.open(filename_nonplanar, std::ios::out);
         resultfile << "## ";
         for (size_t t = 0; t <= pparams.Lt * mparams.sizeWloops; t++) {
@@ -5,7 +5,9 @@
 #include"hamiltonian_field.hh"
 #include"monomial.hh"
 #include"md_params.hh"
+#include"md_update.hh"
 #include"integrator.hh"
+#include<cmath>
 #include<iostream>
 #include<vector>
 #include<list>
@@ -15,42 +17,41 @@
 using std::vector;
 
 
-
-
-template<class URNG, typename Float, class Group> void kramers_md_update(gaugeconfig<su2> &U,
+/**
+ * @brief Kramers (generalised HMC) update: k_max short trajectories with partial
+ * momentum refresh P -> exp(-gamma*tau)*P + sqrt(1-exp(-2*gamma*tau))*eta
+ * (A. M. Horowitz, Phys. Lett. B 268 (1991) 247).
+ * On reject the gauge field is kept and the momenta are reverted and negated.
+ * All the buffers are taken from ws: the MD evolution acts on ws.U_trial, which is
+ * swapped into U on accept, and the refresh kernel writes the momenta and their
+ * copy for the reject in the same pass.
+ */
+template<class URNG, typename Float, class Group> void kramers_md_update(gaugeconfig<Group> &U,
                                                                          URNG &engine, 
                                                                          md_params &params,
                                                                          std::list<monomial<Float, Group>*> &monomial_list, 
-                                                                         integrator<Float, Group> &md_integ) {
-  adjointfield<Float, Group> momenta(U.getLx(), U.getLy(), U.getLz(), U.getLt(), U.getndims());
+                                                                         integrator<Float, Group> &md_integ,
+                                                                         md_workspace<Float, Group> &ws) {
   // generate standard normal distributed random momenta
   // normal distribution checked!
-  initnormal(engine, momenta);
+  initnormal(engine, ws.momenta);
+  if(ws.momenta_save.getSize() != ws.momenta.getSize()) {
+    ws.momenta_save = ws.momenta;
+  }
 
   // for the accept reject step
   std::uniform_real_distribution<Float> uniform(0., 1.);
 
-  const double gamma = params.getgamma();
-  adjointfield<Float, Group> eta(U.getLx(), U.getLy(), U.getLz(), U.getLt(), U.getndims());
-  adjointfield<Float, Group> momenta_old(U.getLx(), U.getLy(), U.getLz(), U.getLt(), U.getndims());
-  gaugeconfig<su2> U_old(U.getLx(), U.getLy(), U.getLz(), U.getLt(), U.getndims(), U.getBeta());
+  // friction over one (short) trajectory of length tau
+  const Float c1 = exp(-params.getgamma()*params.gettau());
 
   for(size_t k = 0; k < params.getkmax(); k++) {
-    // first momenta update
-    initnormal<URNG, Float>(engine, eta);
-    Float epsilon = params.gettau()/Float(params.getnsteps());
-    for(size_t i = 0; i < momenta.getSize(); i++) {
-      momenta[i].seta(momenta[i].geta()*exp(-gamma*epsilon) + sqrt(1 - exp(-2*gamma*epsilon))*eta[i].geta());
-      momenta[i].setb(momenta[i].getb()*exp(-gamma*epsilon) + sqrt(1 - exp(-2*gamma*epsilon))*eta[i].getb());
-      momenta[i].setc(momenta[i].getc()*exp(-gamma*epsilon) + sqrt(1 - exp(-2*gamma*epsilon))*eta[i].getc());
-    }
-
-    momenta_old = momenta;
+    // first momenta update, keeping a copy for the reject
+    partial_refresh(engine, ws.momenta, ws.momenta_save, c1);
 
-    // keep a copy of original gauge field and the momenta
-    U_old = U;
-    
-    hamiltonian_field<Float, Group> h(momenta, U);
+    // the trajectory starts from a copy of the original gauge field
+    ws.U_trial = U;
+    hamiltonian_field<Float, Group> h(ws.momenta, ws.U_trial);
 
     // compute the initial Hamiltonian
     for (auto it = monomial_list.begin(); it != monomial_list.end(); it++) {
@@ -58,9 +59,6 @@ template<class URNG, typename Float, class Group> void kramers_md_update(gaugeco
     }
     
     // perform MD evolution
-    if(params.getnsteps() != 1) {
-      
-    }
     md_integ.integrate(monomial_list, h, params);
     
     // compute the final Hamiltonian
@@ -83,16 +81,25 @@ template<class URNG, typename Float, class Group> void kramers_md_update(gaugeco
       }
     }
 
-    // in case not accepted, restore initial gauge field
-    // and flip sign in momenta
-    if(!params.getaccept()) {
-      U = U_old;
-      if(k < params.getkmax()-1) {
-        momenta = momenta_old;
-        momenta.flipsign();
-      }
+    // in case of acceptance the evolved gauge field becomes the new one,
+    // otherwise U is left untouched and the momenta are reverted with flipped sign
+    if(params.getaccept()) {
+      U.swap(ws.U_trial);
+    }
+    else if(k < params.getkmax()-1) {
+      ws.momenta.swap(ws.momenta_save);
+      ws.momenta.flipsign();
     }
   }
   return;
 }
 
+template<class URNG, typename Float, class Group> void kramers_md_update(gaugeconfig<Group> &U,
+                                                                         URNG &engine, 
+                                                                         md_params &params,
+                                                                         std::list<monomial<Float, Group>*> &monomial_list, 
+                                                                         integrator<Float, Group> &md_integ) {
+  md_workspace<Float, Group> ws(U);
+  kramers_md_update(U, engine, params, monomial_list, md_integ, ws);
+  return;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file link_integral.hh
+ * @brief one-link integrals of the temporal links, for the variance reduction of Wilson
+ * and Polyakov loops
+ *
+ * With the Wilson gauge action a link U_mu(x) is distributed with the weight
+ * exp(beta/N_c Re tr(U_mu(x) K_mu(x))) in the background of all the other links, where
+ * K_mu(x) is the sum of the staples (see get_staples()). The average of U_mu(x) in this
+ * background is known in closed form. With k = |K| for U(1) and k = sqrt(det K) for
+ * SU(2):
+ *   U(1):  <U> = I_1(beta k)/I_0(beta k) K^{*}/k
+ *   SU(2): <U> = I_2(beta k)/I_1(beta k) K^{\dagger}/k
+ * In an observable linear in U_mu(x) the link can be replaced by <U> without changing
+ * the expectation value, but with a much smaller variance. This holds for several
+ * links at once as long as no two of them belong to the same plaquette: in a Wilson
+ * loop the two temporal lines must not be neighbours, i.e. at least two lattice
+ * spacings apart also across the periodic boundary (2 <= r <= L-2), in the Polyakov
+ * loop all the links can be replaced. This is the analytic limit of the
+ * multihit method, i.e. of averaging the link over many heatbath hits.
+ * The weight is the one of the pure gauge Wilson action in flat spacetime (optionally
+ * anisotropic); with dynamical fermions the replacement would bias the results, and the
+ * input parser rejects link_integral together with fermion monomials.
+ */
+
+#pragma once
+
+#include "accum_type.hh"
+#include "gaugeconfig.hh"
+#include "geometry.hh"
+#include "su2.hh"
+#include "u1.hh"
+
+#include <array>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace flat_spacetime {
+
+  /**
+   * @brief ratio I_{n+1}(x)/I_n(x) of modified Bessel functions of the first kind
+   * Computed with the backward recurrence I_{k-1}/I_k = 2k/x + I_{k+1}/I_k, which is
+   * stable and, unlike the ratio of std::cyl_bessel_i, does not overflow for large x.
+   */
+  inline double bessel_ratio(const size_t &n, const double &x) {
+    if (x <= 0.) {
+      return 0.;
+    }
+    double r = 0.;
+    for (size_t k = n + 40 + 2 * size_t(x); k > n; k--) {
+      r = x / (2.0 * k + x * r);
+    }
+    return r;
+  }
+
+  // k = |K| (U(1)) and sqrt(det K) (SU(2)), K proportional to a group element
+  inline double link_norm(const Complex &K) { return std::abs(K); }
+  inline double link_norm(const _su2 &K) {
+    return std::sqrt(std::norm(K.geta()) + std::norm(K.getb()));
+  }
+
+  /**
+   * @brief one-link integrals <U_0(x)> of all the temporal links of U
+   *
+   * @param U gauge configuration, U.getBeta() is the coupling of the Wilson action
+   * @param xi bare anisotropy
+   * @param anisotropic true for the anisotropic Wilson action
+   * @return <U_0(x)>, indexed by the site index of x
+   */
+  template <class Group>
+  std::vector<typename accum_type<Group>::type> temporal_link_integrals(
+    const gaugeconfig<Group> &U, const double &xi = 1.0, const bool &anisotropic = false) {
+    typedef typename accum_type<Group>::type accum;
+    const size_t d = U.getndims();
+    const size_t V = U.getVolume();
+    const geometry g(U.getLx(), U.getLy(), U.getLz(), U.getLt());
+    // temporal-spatial plaquettes only
+    const double factor = anisotropic ? 1.0 / xi : 1.0;
+    std::vector<accum> Ubar(V);
+
+#pragma omp parallel for
+    for (size_t s = 0; s < V; s++) {
+      std::array<int, 4> x;
+      size_t r = s;
+      x[3] = r % g.getLz();
+      r /= g.getLz();
+      x[2] = r % g.getLy();
+      r /= g.getLy();
+      x[1] = r % g.getLx();
+      x[0] = r / g.getLx();
+
+      // link U_mu(x + a*0 + b*nu)
+      auto link = [&](const size_t &nu, const int &a, const int &b, const size_t &mu) {
+        std::array<int, 4> y = x;
+        y[0] += a;
+        y[nu] += b;
+        return U[g.getIndex(y[0], y[1], y[2], y[3]) * d + mu];
+      };
+
+      // staples as in get_staples()
+      accum K;
+      for (size_t nu = 1; nu < d; nu++) {
+        K += factor * (link(nu, 1, 0, nu) * link(nu, 0, 1, 0).dagger() *
+                       link(nu, 0, 0, nu).dagger());
+        K += factor * (link(nu, 1, -1, nu).dagger() * link(nu, 0, -1, 0).dagger() *
+                       link(nu, 0, -1, nu));
+      }
+      const double k = link_norm(K);
+      if (k > 0.) {
+        const double c = bessel_ratio(U.getNc() - 1, U.getBeta() * k) / k;
+        Ubar[s] = Complex(c, 0.) * dagger(K);
+      } else {
+        Ubar[s] = accum();
+      }
+    }
+    return Ubar;
+  }
+
+} // namespace flat_spacetime
@@ -1,69 +1,161 @@
+/**
+ * @file lyapunov.hh
+ * @brief Lyapunov exponent of the molecular dynamics evolution
+ *
+ * K copies of a gauge configuration are perturbed by random gauge fields of size
+ * delta and evolved with the same momenta and the same MD integrator as the reference
+ * configuration. For a chaotic evolution the distance between each copy and the
+ * reference grows as d(t) ~ d(0) * exp(lambda * t), and the slope of log(d(t)/d(0))
+ * gives one estimate of lambda per copy. The spread of the K estimates gives the
+ * statistical error.
+ *
+ * All the copies are advanced in lockstep, one MD step at a time, such that each step
+ * uses the threaded kernels of the integrator and the distances are available after
+ * every step.
+ */
+
 #pragma once
 
-#include"gaugeconfig.hh"
-#include"adjointfield.hh"
-#include"hamiltonian_field.hh"
-#include"md_params.hh"
-#include"integrator.hh"
-#include<iostream>
-#include<vector>
-#include<list>
-#include<random>
-#include<iostream>
-#include<fstream>
-#include<cmath>
-#include<complex>
+#include "adjointfield.hh"
+#include "gaugeconfig.hh"
+#include "hamiltonian_field.hh"
+#include "integrator.hh"
+#include "md_params.hh"
+#include "monomial.hh"
+#include "parallel_reduction.hh"
+#include "su2.hh"
+#include "u1.hh"
+#include "update_gauge.hh"
 
-using std::vector;
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <vector>
 
-// this performs two parallel MD integrations
-// starting from identical momenta
-// and up to rounding the same gauge fields
+namespace lyapunov {
 
-template<typename Float, class URNG, class Group> void compute_lyapunov(gaugeconfig<Group> &U, 
-                                                                        URNG &engine, 
-                                                                        md_params params,
-                                                                        std::list<monomial<Float, Group>*> &monomial_list, 
-                                                                        integrator<Float, Group> &md_integ, 
-                                                                        std::string const &path, 
-                                                                        const size_t d = 12) {
+  /**
+   * @brief squared distance \sum_{x,mu} |U_mu(x) - V_mu(x)|^2 (see link_distance2())
+   * The sum does not depend on the number of threads (see parallel_reduction.hh).
+   */
+  template <class Group>
+  double distance2(const gaugeconfig<Group> &U, const gaugeconfig<Group> &V) {
+    return parallel_reduction::deterministic_sum<double>(
+      U.getSize(), [&](const size_t &i) { return link_distance2(U[i], V[i]); });
+  }
 
-  const size_t n = pow(10, d);
+  /**
+   * @brief estimate of the Lyapunov exponent with its statistical error
+   */
+  struct result {
+    double lambda = 0.; // mean over the copies
+    double error = 0.; // standard error of the mean
+  };
 
-  adjointfield<Float, Group> momenta(U.getLx(), U.getLy(), U.getLz(), U.getLt(), U.getndims());
-  // generate standard normal distributed random momenta
-  initnormal(engine, momenta);
-  adjointfield<Float, Group> momenta2(momenta);
-  
-  // generate copy of U, but round to d decimal digits
-  gaugeconfig<Group> U2(U.getLx(), U.getLy(), U.getLz(), U.getLt(), U.getBeta());
-  if(d != 0) {
-    for(size_t i = 0; i < U.getSize(); i++) {
-      U2[i] = U[i].round(n);
+  /**
+   * @brief slope of the least squares fit y = a + lambda*t
+   */
+  inline double fit_slope(const std::vector<double> &t, const std::vector<double> &y) {
+    const size_t n = t.size();
+    double st = 0., sy = 0., stt = 0., sty = 0.;
+    for (size_t j = 0; j < n; j++) {
+      st += t[j];
+      sy += y[j];
+      stt += t[j] * t[j];
+      sty += t[j] * y[j];
     }
+    const double den = n * stt - st * st;
+    return (den > 0.) ? (n * sty - st * sy) / den : 0.;
   }
-  else {
-    for(size_t i = 0; i < U.getSize(); i++) {
-      U2[i] = U[i];
+
+  /**
+   * @brief measure the Lyapunov exponent of the MD evolution starting from U
+   *
+   * Each step is one MD step of length tau/n_steps of `params`. The monomials are used
+   * as they are: the pseudo-fermion fields of the last trajectory are kept fixed and
+   * no heatbath is done, such that the Markov chain is not affected.
+   * After every step one line "step t d_1 ... d_K <log(d/d0)>" is written to os, where
+   * d_k is the distance of copy k from the reference.
+   *
+   * @param U starting configuration (not modified)
+   * @param engine random number generator for the momenta and the perturbations
+   * @param params MD parameters
+   * @param monomial_list monomials in the action
+   * @param md_integ MD integrator
+   * @param n_copies number K of perturbed copies
+   * @param delta size of the perturbation: U -> exp(delta*eta)*U, eta standard normal
+   * @param n_steps number of MD steps
+   * @param os output stream, flushed after each step
+   */
+  template <typename Float, class URNG, class Group>
+  result compute_lyapunov(const gaugeconfig<Group> &U,
+                          URNG &engine,
+                          md_params params,
+                          std::list<monomial<Float, Group> *> &monomial_list,
+                          integrator<Float, Group> &md_integ,
+                          const size_t &n_copies,
+                          const double &delta,
+                          const size_t &n_steps,
+                          std::ostream &os) {
+    const double dtau = params.gettau() / params.getnsteps();
+    params.settau(dtau);
+    params.setnsteps(1);
+
+    // reference and perturbed copies, all starting from the same momenta
+    std::vector<gaugeconfig<Group>> V(n_copies + 1, U);
+    adjointfield<Float, Group> P(U.getLx(), U.getLy(), U.getLz(), U.getLt(),
+                                 U.getndims());
+    initnormal(engine, P);
+    std::vector<adjointfield<Float, Group>> momenta(n_copies + 1, P);
+
+    std::vector<double> d0(n_copies + 1, 0.);
+    for (size_t k = 1; k <= n_copies; k++) {
+      initnormal(engine, P);
+      hamiltonian_field<Float, Group> eta(P, V[k]);
+      update_gauge(eta, Float(delta), true);
+      d0[k] = std::sqrt(distance2(V[0], V[k]));
     }
-  }
-  
-  hamiltonian_field<Float, Group> h(momenta, U);
-  hamiltonian_field<Float, Group> h2(momenta2, U2);
 
-  double dtau = params.gettau() / params.getnsteps();
-  params.settau(dtau);
-  params.setnsteps(1);
+    std::vector<hamiltonian_field<Float, Group>> h;
+    for (size_t k = 0; k <= n_copies; k++) {
+      h.push_back(hamiltonian_field<Float, Group>(momenta[k], V[k]));
+    }
+
+    std::vector<double> t(n_steps);
+    std::vector<std::vector<double>> logd(n_copies + 1, std::vector<double>(n_steps));
+    for (size_t s = 0; s < n_steps; s++) {
+      for (size_t k = 0; k <= n_copies; k++) {
+        md_integ.integrate(monomial_list, h[k], params);
+      }
+      t[s] = (s + 1) * dtau;
+
+      os << s << " " << std::scientific << std::setprecision(8) << t[s];
+      double mean = 0.;
+      for (size_t k = 1; k <= n_copies; k++) {
+        const double d = std::sqrt(distance2(V[0], V[k]));
+        logd[k][s] = std::log(d / d0[k]);
+        mean += logd[k][s];
+        os << " " << d;
+      }
+      os << " " << mean / n_copies << std::endl;
+    }
 
-  std::ofstream os(path, std::ios::out);
-  for(size_t t = 0; t < 100; t++) {
-    md_integ.integrate(monomial_list, h, params, false);
-    md_integ.integrate(monomial_list, h2, params, false);
-    double sum = 0.;
-    for(size_t i = 0; i < U.getSize(); i++) {
-      sum += norm(U[i].geta() - U2[i].geta()) + norm(U[i].getb() - U2[i].getb());
+    // one estimate per copy, then mean and standard error
+    result res;
+    std::vector<double> lambda(n_copies + 1, 0.);
+    for (size_t k = 1; k <= n_copies; k++) {
+      lambda[k] = fit_slope(t, logd[k]);
+      res.lambda += lambda[k] / n_copies;
+    }
+    if (n_copies > 1) {
+      double var = 0.;
+      for (size_t k = 1; k <= n_copies; k++) {
+        var += (lambda[k] - res.lambda) * (lambda[k] - res.lambda);
+      }
+      res.error = std::sqrt(var / (n_copies - 1) / n_copies);
     }
-    os << t << " " << sum << std::endl;
+    return res;
   }
-  return;
-}
+
+} // namespace lyapunov
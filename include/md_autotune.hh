@@ -0,0 +1,280 @@
+/**
+ * @file md_autotune.hh
+ * @brief automatic tuning of the MD integrator of the HMC
+ *
+ * For a given configuration the energy violation dH of a trajectory is measured for
+ * several integrators and step sizes. For a reversible integrator of order p one has
+ * <dH^2> = c * dtau^(2p) asymptotically, and the acceptance rate is predicted from
+ * <dH^2> as erfc(sqrt(<dH^2>/8)) (S. Gupta et al., Phys. Lett. B 242 (1990) 437).
+ * Fitting c (and the exponent) for each candidate integrator allows to choose the
+ * cheapest setup, in units of force evaluations per trajectory, that reaches a target
+ * acceptance rate. For omf2 the parameter lambda is tuned as well, by minimizing <dH^2>
+ * at fixed step size.
+ *
+ * The trial trajectories act on copies of the gauge field, hence the Markov chain is
+ * not affected by the tuning. The chosen setup is saved (see save_tuning()), such that
+ * a restarted run continues with the same integrator instead of tuning again.
+ */
+
+#pragma once
+
+#include "gaugeconfig.hh"
+#include "integrator.hh"
+#include "md_params.hh"
+#include "md_update.hh"
+#include "monomial.hh"
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace md_autotune {
+
+  /**
+   * @brief properties of an integrator relevant for the tuning
+   * order: dH per trajectory scales as dtau^order
+   * n_force: number of force evaluations per MD step
+   */
+  struct integrator_traits {
+    size_t order;
+    size_t n_force;
+  };
+
+  /**
+   * @brief get the traits of the integrator called `name`
+   * @return false if the integrator cannot be tuned (e.g. low precision or
+   * non-reversible integrators)
+   */
+  inline bool get_traits(const std::string &name, integrator_traits &it) {
+    if (name == "leapfrog") {
+      it = {2, 1};
+    } else if (name == "omf2") {
+      it = {2, 2};
+    } else if (name == "omf4") {
+      it = {4, 5};
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief predicted acceptance rate for a given <dH^2>
+   */
+  inline double acceptance(const double &dH2) { return std::erfc(std::sqrt(dH2 / 8.0)); }
+
+  /**
+   * @brief setup chosen by the tuning
+   */
+  struct tuning_result {
+    std::string integrator = "leapfrog";
+    double lambda = 0.1938; // only meaningful for omf2
+    size_t n_steps = 1;
+    size_t cost = 0; // force evaluations per trajectory
+    double acceptance = 0.; // predicted acceptance rate
+  };
+
+  // values of lambda scanned for omf2
+  const std::vector<double> omf2_lambdas = {0.16, 0.18, 0.1938, 0.21, 0.23};
+
+  /**
+   * @brief create an integrator without printing it (the tuning creates many)
+   */
+  template <typename Float, class Group>
+  integrator<Float, Group> *make_integrator(const std::string &name,
+                                            const double &lambda) {
+    if (name == "omf2") {
+      return new omf2<Float, Group>(lambda);
+    } else if (name == "omf4") {
+      return new omf4<Float, Group>();
+    }
+    return new leapfrog<Float, Group>();
+  }
+
+  /**
+   * @brief average of dH^2 over n_traj trial trajectories started from U
+   *
+   * The same seeds are used for every setup, which reduces the noise in the
+   * comparison of different setups.
+   */
+  template <typename Float, class Group>
+  double mean_dH2(const gaugeconfig<Group> &U,
+                  const size_t &seed,
+                  const size_t &n_traj,
+                  md_params params,
+                  std::list<monomial<Float, Group> *> &monomial_list,
+                  integrator<Float, Group> &md_integ) {
+    params.disablerevtest();
+    double res = 0.;
+    gaugeconfig<Group> V(U);
+    md_workspace<Float, Group> ws(U);
+    for (size_t k = 0; k < n_traj; k++) {
+      if (k > 0) {
+        V = U;
+      }
+      std::mt19937 engine(seed + k);
+      md_update(V, engine, params, monomial_list, md_integ, ws);
+      res += params.getdeltaH() * params.getdeltaH();
+    }
+    return res / double(n_traj);
+  }
+
+  /**
+   * @brief tune the integrator on the configuration U
+   *
+   * @param U gauge configuration (not modified)
+   * @param seed seed for the trial trajectories
+   * @param n_traj number of trial trajectories for each measured setup
+   * @param target target acceptance rate
+   * @param names names of the candidate integrators
+   * @param params MD parameters: tau and the reference number of steps
+   * @param monomial_list monomials in the action
+   */
+  template <typename Float, class Group>
+  tuning_result tune(const gaugeconfig<Group> &U,
+                     const size_t &seed,
+                     const size_t &n_traj,
+                     const double &target,
+                     const std::vector<std::string> &names,
+                     const md_params &params,
+                     std::list<monomial<Float, Group> *> &monomial_list) {
+    tuning_result best;
+    bool found = false;
+    const double tau = params.gettau();
+    const size_t n0 = params.getnsteps() > 0 ? params.getnsteps() : 1;
+    const size_t n1 = 2 * n0;
+    const size_t n_max = 1000 * n1; // upper bound for the number of steps
+
+    for (size_t j = 0; j < names.size(); j++) {
+      integrator_traits it;
+      if (!get_traits(names[j], it)) {
+        std::cout << "## autotune: integrator " << names[j]
+                  << " cannot be tuned, skipping it\n";
+        continue;
+      }
+      md_params p0 = params, p1 = params;
+      p0.setnsteps(n0);
+      p1.setnsteps(n1);
+
+      // for omf2 keep the lambda with the smallest <dH^2> at the reference step size
+      double lambda = 0.1938;
+      double dH2_0 = 0.;
+      const std::vector<double> lambdas =
+        (names[j] == "omf2") ? omf2_lambdas : std::vector<double>({lambda});
+      for (size_t l = 0; l < lambdas.size(); l++) {
+        integrator<Float, Group> *integ = make_integrator<Float, Group>(names[j], lambdas[l]);
+        const double dH2 = mean_dH2(U, seed, n_traj, p0, monomial_list, *integ);
+        delete integ;
+        if (names[j] == "omf2") {
+          std::cout << "## autotune: omf2 lambda=" << lambdas[l] << " n_steps=" << n0
+                    << " <dH^2>=" << dH2 << "\n";
+        }
+        if (l == 0 || dH2 < dH2_0) {
+          dH2_0 = dH2;
+          lambda = lambdas[l];
+        }
+      }
+      integrator<Float, Group> *integ = make_integrator<Float, Group>(names[j], lambda);
+      const double dH2_1 = mean_dH2(U, seed, n_traj, p1, monomial_list, *integ);
+      delete integ;
+
+      // fit <dH^2> = c * dtau^a. Away from the asymptotic regime the fitted exponent
+      // can be far off, so both the fitted and the asymptotic exponent 2*order are used
+      // and the more conservative (larger) number of steps is taken
+      const double dtau0 = tau / double(n0);
+      double a = std::log(dH2_0 / dH2_1) / std::log(2.0);
+      if (!std::isfinite(a) || a <= 0.) {
+        a = 2.0 * it.order;
+      }
+      size_t n = 1;
+      for (const double &e : {a, 2.0 * it.order}) {
+        const double c = dH2_0 / std::pow(dtau0, e);
+        size_t m = 1;
+        while (m < n_max && !(acceptance(c * std::pow(tau / double(m), e)) >= target)) {
+          m++;
+        }
+        if (m > n) {
+          n = m;
+          a = e;
+        }
+      }
+      const double acc = acceptance(dH2_0 / std::pow(dtau0, a) * std::pow(tau / double(n), a));
+      const size_t cost = n * it.n_force;
+
+      std::cout << "## autotune: " << names[j];
+      if (names[j] == "omf2") {
+        std::cout << " lambda=" << lambda;
+      }
+      std::cout << " <dH^2>(n_steps=" << n0 << ")=" << dH2_0 << " <dH^2>(n_steps=" << n1
+                << ")=" << dH2_1 << " exponent=" << a << " -> n_steps=" << n
+                << " cost=" << cost << " predicted acceptance=" << acc << "\n";
+
+      if (!found || cost < best.cost) {
+        found = true;
+        best.integrator = names[j];
+        best.lambda = lambda;
+        best.n_steps = n;
+        best.cost = cost;
+        best.acceptance = acc;
+      }
+    }
+    if (!found) {
+      spacetime_lattice::fatal_error("No tunable integrator among the candidates.",
+                                     __func__);
+    }
+    return best;
+  }
+
+  /**
+   * @brief write the tuned setup and the trajectory length to path
+   */
+  inline void save_tuning(const std::string &path,
+                          const tuning_result &res,
+                          const double &tau) {
+    std::ofstream ofs(path, std::ios::out);
+    ofs << "integrator lambda n_steps tau acceptance\n";
+    ofs << std::setprecision(16) << res.integrator << " " << res.lambda << " "
+        << res.n_steps << " " << tau << " " << res.acceptance << "\n";
+    ofs.close();
+    if (!ofs) {
+      spacetime_lattice::fatal_error("Cannot write the tuned integrator to " + path,
+                                     __func__);
+    }
+  }
+
+  /**
+   * @brief read the setup written by save_tuning()
+   * @return false (res unchanged) if the file does not exist, cannot be read or was
+   * tuned for a different trajectory length
+   */
+  inline bool load_tuning(const std::string &path, tuning_result &res, const double &tau) {
+    std::ifstream ifs(path, std::ios::in);
+    if (!ifs) {
+      return false;
+    }
+    std::string header;
+    std::getline(ifs, header);
+    tuning_result r;
+    double tau_file = 0.;
+    ifs >> r.integrator >> r.lambda >> r.n_steps >> tau_file >> r.acceptance;
+    integrator_traits it;
+    if (!ifs || !get_traits(r.integrator, it) || r.n_steps == 0) {
+      std::cerr << "## Warning: ignoring the corrupted tuning file " << path << std::endl;
+      return false;
+    }
+    if (std::abs(tau_file - tau) > 1e-12 * tau) {
+      std::cerr << "## Warning: ignoring " << path << ", tuned for tau=" << tau_file
+                << std::endl;
+      return false;
+    }
+    r.cost = r.n_steps * it.n_force;
+    res = r;
+    return true;
+  }
+
+} // namespace md_autotune
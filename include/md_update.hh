@@ -15,28 +15,49 @@
 using std::vector;
 
 
+/**
+ * @brief buffers needed by a HMC trajectory
+ * They are kept alive between trajectories, such that md_update does not allocate
+ * memory. U_trial and U_save are sized at the first trajectory (see md_update),
+ * momenta_save at the first Kramers update (see kramers_md_update.hh).
+ */
+template<typename Float, class Group> struct md_workspace {
+  adjointfield<Float, Group> momenta; // conjugate momenta
+  adjointfield<Float, Group> momenta_save; // momenta at the start of a Kramers step
+  gaugeconfig<Group> U_trial; // gauge field evolved along the trajectory
+  gaugeconfig<Group> U_save; // end point of the trajectory during the reversibility test
+
+  md_workspace(const gaugeconfig<Group> &U) :
+    momenta(U.getLx(), U.getLy(), U.getLz(), U.getLt(), U.getndims()),
+    momenta_save(0, 0, 0, 0, U.getndims()) {}
+};
+
+/**
+ * @brief HMC trajectory using the persistent buffers in ws
+ * The MD evolution acts on ws.U_trial. On accept the new field is swapped into U,
+ * on reject U is simply left untouched: no copy is needed in either case.
+ */
 template<class URNG, typename Float, class Group> void md_update(gaugeconfig<Group> &U,
                                                                  URNG &engine, 
                                                                  md_params &params,
                                                                  std::list<monomial<Float, Group>*> &monomial_list, 
-                                                                 integrator<Float, Group> &md_integ) {
-  adjointfield<Float, Group> momenta(U.getLx(), U.getLy(), U.getLz(), U.getLt(), U.getndims());
+                                                                 integrator<Float, Group> &md_integ,
+                                                                 md_workspace<Float, Group> &ws) {
   // generate standard normal distributed random momenta
   // normal distribution checked!
-  initnormal(engine, momenta);
+  initnormal(engine, ws.momenta);
 
   std::uniform_real_distribution<Float> uniform(0., 1.);
 
-  hamiltonian_field<Float, Group> h(momenta, U);
+  // the trajectory starts from a copy of the original gauge field
+  ws.U_trial = U;
+  hamiltonian_field<Float, Group> h(ws.momenta, ws.U_trial);
 
   // compute the initial Hamiltonian
   for (auto it = monomial_list.begin(); it != monomial_list.end(); it++) {
     (*it)->heatbath(h); 
   }
 
-  // keep a copy of original gauge field
-  gaugeconfig<Group> U_old(U);
-
   // perform MD evolution
   md_integ.integrate(monomial_list, h, params);
 
@@ -61,7 +82,7 @@ template<class URNG, typename Float, class Group> void md_update(gaugeconfig<Gro
   // if wanted, perform a reversibility violation test.
   if(params.getrevtest()) {
     delta_H = 0.;
-    gaugeconfig<Group> U_save(U);
+    ws.U_save = ws.U_trial;
     h.momenta->flipsign();
     md_integ.integrate(monomial_list, h, params);
 
@@ -70,14 +91,22 @@ template<class URNG, typename Float, class Group> void md_update(gaugeconfig<Gro
       delta_H += (*it)->getDeltaH();
     }
     params.setdeltadeltaH(delta_H);
-    U = U_save;
+    ws.U_trial.swap(ws.U_save);
   }
 
-  // in case not accepted, restore initial gauge field
-  if(!params.getaccept()) {
-    U = U_old;
+  // in case of acceptance, the evolved gauge field becomes the new one
+  if(params.getaccept()) {
+    U.swap(ws.U_trial);
   }
   return;
 }
 
-
+template<class URNG, typename Float, class Group> void md_update(gaugeconfig<Group> &U,
+                                                                 URNG &engine, 
+                                                                 md_params &params,
+                                                                 std::list<monomial<Float, Group>*> &monomial_list, 
+                                                                 integrator<Float, Group> &md_integ) {
+  md_workspace<Float, Group> ws(U);
+  md_update(U, engine, params, monomial_list, md_integ, ws);
+  return;
+}
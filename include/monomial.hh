@@ -9,6 +9,7 @@ public:
   monomial(unsigned int _timescale)
     : Hold(0.), Hnew(0.), timescale(_timescale), mdactive(true) {}
   monomial() : Hold(0.), Hnew(0.), timescale(0), mdactive(true) {}
+  virtual ~monomial() {}
   virtual void heatbath(hamiltonian_field<Float, Group> const &h) = 0;
   virtual void accept(hamiltonian_field<Float, Group> const &h) = 0;
   virtual void derivative(adjointfield<Float, Group> &deriv,
@@ -0,0 +1,260 @@
+/**
+ * @file multilevel.hh
+ * @brief multilevel measurement of Polyakov loop correlators and Wilson loops
+ *
+ * The time direction is divided into n = Lt/thickness slabs. With the spatial links on
+ * the slab boundaries kept fixed, the links inside different slabs are independent (see
+ * slab_sweep()). The temporal lines through the slabs then factorise: with L_s(x) the
+ * product of the temporal links of slab s at the spatial site x and y = x + r*mu, the
+ * two-link operator
+ *   M_s(x,y)_{(a d),(b c)} = L_s(x)_{ab} L_s(y)^*_{dc}
+ * is averaged over n_sub configurations of the slab, each generated from the previous
+ * one by n_sweeps sub-updates. The averaged operators of consecutive slabs are
+ * multiplied as N_c^2 x N_c^2 matrices:
+ *   P(x) P(y)^*      = tr(M_0 M_1 ... M_{n-1})
+ *   W(r, k*thickness) = \sum_{abcd} (M_s ... M_{s+k-1})_{(a d),(b c)} S'_{bc} S^*_{ad}
+ * where S and S' are the spatial lines from x to y on the lower and upper boundary.
+ * Every factor is an average over n_sub slab configurations, such that the noise of a
+ * correlator spanning k slabs is reduced exponentially in k. This is one level of the
+ * algorithm of Luescher and Weisz, JHEP 0109 (2001) 010.
+ * The sub-updates of different slabs run concurrently, each slab with its own random
+ * number generator, such that the results do not depend on the number of threads.
+ */
+
+#pragma once
+
+#include "accum_type.hh"
+#include "flat-sweep.hh"
+#include "gaugeconfig.hh"
+#include "geometry.hh"
+#include "su2.hh"
+#include "u1.hh"
+#include "wilsonloop.hh"
+
+#include <array>
+#include <complex>
+#include <random>
+#include <vector>
+
+namespace multilevel {
+
+  // N_c x N_c matrix of a group element, row-major
+  inline std::array<Complex, 4> matrix(const _u1 &U) {
+    return {Complex(U), 0., 0., 0.};
+  }
+  inline std::array<Complex, 4> matrix(const _su2 &U) {
+    return {U.geta(), U.getb(), -std::conj(U.getb()), std::conj(U.geta())};
+  }
+
+  /**
+   * @brief multilevel estimates of the Polyakov loop correlator and the Wilson loops
+   */
+  struct result {
+    std::vector<double> polyakov; // <Re P(x) P(x+r*mu)^*>, P = tr, index r-1
+    std::vector<std::vector<double>> wilson; // W(r, k*thickness), index [k-1][r-1]
+    double acceptance = 0.; // mean acceptance rate of the sub-updates
+  };
+
+  /**
+   * @brief multilevel measurement on the configuration U
+   *
+   * The Polyakov loop is the trace of the product of the temporal links, not divided by
+   * N_c as in polyakov_loop(), such that the correlator is N_c^2 on the unit
+   * configuration. The Wilson loops are divided by N_c and are 1 there. Averages are over all spatial sites x and spatial directions mu, the
+   * Wilson loops also over the n slab boundaries they can start from. T = k*thickness
+   * runs from thickness to (n-1)*thickness.
+   * With n_sub=1 and n_sweeps=0 the links are not changed and the results are the ones
+   * of the standard estimators on U.
+   *
+   * @param U gauge configuration (not modified), U.getBeta() is the coupling
+   * @param thickness number of time slices in a slab, must divide Lt
+   * @param rmax largest spatial distance
+   * @param n_sub number of slab configurations per average
+   * @param n_sweeps slab sweeps between two slab configurations
+   * @param N_hit Metropolis hits per link in a slab sweep
+   * @param delta size of the Metropolis steps
+   * @param seed seed of the random number generator of slab s is seed + s
+   * @param xi bare anisotropy
+   * @param anisotropic true for the anisotropic Wilson action
+   */
+  template <class Group>
+  result compute_multilevel(const gaugeconfig<Group> &U,
+                            const size_t &thickness,
+                            const size_t &rmax,
+                            const size_t &n_sub,
+                            const size_t &n_sweeps,
+                            const size_t &N_hit,
+                            const double &delta,
+                            const size_t &seed,
+                            const double &xi = 1.0,
+                            const bool &anisotropic = false) {
+    const size_t Lt = U.getLt();
+    if (thickness == 0 || Lt % thickness != 0) {
+      spacetime_lattice::fatal_error("the slab thickness must divide Lt", __func__);
+    }
+    if (n_sub == 0) {
+      spacetime_lattice::fatal_error("at least one sub-measurement is needed", __func__);
+    }
+    const size_t n_slabs = Lt / thickness;
+    const size_t d = U.getndims();
+    const size_t n_dirs = d - 1;
+    const size_t Vs = U.getVolume() / Lt;
+    const size_t N = U.getNc();
+    const size_t N2 = N * N;
+    const size_t N4 = N2 * N2;
+    const size_t n_pairs = Vs * n_dirs * rmax;
+    const site_shift shift(U);
+    // pair of sites (x, x + r*mu) on the same time slice
+    auto pair = [&](const size_t &xs, const size_t &mu, const size_t &r) {
+      return (xs * n_dirs + mu - 1) * rmax + r - 1;
+    };
+
+    // averaged two-link operators of each slab, M[s][pair * N4 + row * N2 + col]
+    gaugeconfig<Group> W = U;
+    std::vector<std::vector<Complex>> M(n_slabs,
+                                        std::vector<Complex>(n_pairs * N4, 0.));
+    std::vector<double> acceptance(n_slabs, 0.);
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t s = 0; s < n_slabs; s++) {
+      std::mt19937 engine(seed + s);
+      const size_t t0 = s * thickness;
+      std::vector<std::array<Complex, 4>> L(Vs);
+      for (size_t n = 0; n < n_sub; n++) {
+        for (size_t k = 0; k < n_sweeps; k++) {
+          acceptance[s] += flat_spacetime::slab_sweep(
+            W, engine, t0, thickness, delta, N_hit, U.getBeta(), xi, anisotropic);
+        }
+        for (size_t xs = 0; xs < Vs; xs++) {
+          Group l = W[(t0 * Vs + xs) * d];
+          for (size_t k = 1; k < thickness; k++) {
+            l = l * W[((t0 + k) * Vs + xs) * d];
+          }
+          L[xs] = matrix(l);
+        }
+        for (size_t xs = 0; xs < Vs; xs++) {
+          for (size_t mu = 1; mu < d; mu++) {
+            size_t ys = xs;
+            for (size_t r = 1; r <= rmax; r++) {
+              ys = shift(ys, mu, 1);
+              Complex *m = &M[s][pair(xs, mu, r) * N4];
+              for (size_t a = 0; a < N; a++) {
+                for (size_t b = 0; b < N; b++) {
+                  for (size_t c = 0; c < N; c++) {
+                    for (size_t e = 0; e < N; e++) {
+                      m[(a * N + e) * N2 + b * N + c] +=
+                        L[xs][a * N + b] * std::conj(L[ys][e * N + c]);
+                    }
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+      for (auto &m : M[s]) {
+        m /= double(n_sub);
+      }
+    }
+    W.touch();
+
+    // spatial lines on the slab boundaries, from the links of U
+    std::vector<std::array<Complex, 4>> S(n_slabs * n_pairs);
+#pragma omp parallel for
+    for (size_t xs = 0; xs < Vs; xs++) {
+      for (size_t s = 0; s < n_slabs; s++) {
+        for (size_t mu = 1; mu < d; mu++) {
+          size_t y = s * thickness * Vs + xs;
+          Group line(typename accum_type<Group>::type(1., 0.));
+          for (size_t r = 1; r <= rmax; r++) {
+            line = line * U[y * d + mu];
+            y = shift(y, mu, 1);
+            S[s * n_pairs + pair(xs, mu, r)] = matrix(line);
+          }
+        }
+      }
+    }
+
+    // contributions of each spatial site: Polyakov correlator, then W for k = 1..n-1
+    const size_t n_obs = n_slabs * rmax;
+    std::vector<double> contrib(Vs * n_obs, 0.);
+#pragma omp parallel for
+    for (size_t xs = 0; xs < Vs; xs++) {
+      std::vector<Complex> R(N4), tmp(N4);
+      auto multiply = [&](const Complex *B) {
+        for (size_t i = 0; i < N2; i++) {
+          for (size_t j = 0; j < N2; j++) {
+            Complex sum = 0.;
+            for (size_t k = 0; k < N2; k++) {
+              sum += R[i * N2 + k] * B[k * N2 + j];
+            }
+            tmp[i * N2 + j] = sum;
+          }
+        }
+        R.swap(tmp);
+      };
+      double *cx = &contrib[xs * n_obs];
+
+      for (size_t mu = 1; mu < d; mu++) {
+        for (size_t r = 1; r <= rmax; r++) {
+          const size_t p = pair(xs, mu, r);
+          R.assign(M[0].begin() + p * N4, M[0].begin() + (p + 1) * N4);
+          for (size_t s = 1; s < n_slabs; s++) {
+            multiply(&M[s][p * N4]);
+          }
+          for (size_t i = 0; i < N2; i++) {
+            cx[r - 1] += std::real(R[i * N2 + i]);
+          }
+
+          for (size_t s0 = 0; s0 < n_slabs; s0++) {
+            const std::array<Complex, 4> &Sl = S[s0 * n_pairs + p];
+            R.assign(M[s0].begin() + p * N4, M[s0].begin() + (p + 1) * N4);
+            for (size_t k = 1; k < n_slabs; k++) {
+              if (k > 1) {
+                multiply(&M[(s0 + k - 1) % n_slabs][p * N4]);
+              }
+              const std::array<Complex, 4> &Su = S[((s0 + k) % n_slabs) * n_pairs + p];
+              Complex w = 0.;
+              for (size_t a = 0; a < N; a++) {
+                for (size_t e = 0; e < N; e++) {
+                  for (size_t b = 0; b < N; b++) {
+                    for (size_t c = 0; c < N; c++) {
+                      w += R[(a * N + e) * N2 + b * N + c] * Su[b * N + c] *
+                           std::conj(Sl[a * N + e]);
+                    }
+                  }
+                }
+              }
+              cx[k * rmax + r - 1] += std::real(w);
+            }
+          }
+        }
+      }
+    }
+
+    result res;
+    res.polyakov.assign(rmax, 0.);
+    res.wilson.assign(n_slabs - 1, std::vector<double>(rmax, 0.));
+    for (size_t xs = 0; xs < Vs; xs++) {
+      for (size_t r = 0; r < rmax; r++) {
+        res.polyakov[r] += contrib[xs * n_obs + r];
+        for (size_t k = 1; k < n_slabs; k++) {
+          res.wilson[k - 1][r] += contrib[xs * n_obs + k * rmax + r];
+        }
+      }
+    }
+    for (size_t r = 0; r < rmax; r++) {
+      res.polyakov[r] /= double(Vs * n_dirs);
+      for (size_t k = 1; k < n_slabs; k++) {
+        res.wilson[k - 1][r] /= double(Vs * n_dirs * n_slabs * N);
+      }
+    }
+    if (n_sweeps > 0) {
+      for (size_t s = 0; s < n_slabs; s++) {
+        res.acceptance += acceptance[s] / double(n_slabs * n_sub * n_sweeps);
+      }
+    }
+    return res;
+  }
+
+} // namespace multilevel
@@ -0,0 +1,163 @@
+// multishift_CG.hpp
+/*
+Multi-shift Conjugate Gradient method
+
+Solves (A + sigma_k) x_k = b for several shifts sigma_k >= 0 at the cost of a
+single CG on A: the Krylov spaces of the shifted systems coincide, hence the
+shifted residuals are collinear with the one of the unshifted system and only
+one matrix-vector product per iteration is needed.
+Reference: B. Jegerlehner, "Krylov space solvers for shifted linear systems",
+https://arxiv.org/abs/hep-lat/9612014
+*/
+
+#pragma once
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace CG {
+
+  /**
+   * Multi-shift Conjugate Gradient method class
+   * @Float = type for the residual and the shifts
+   * @T = type stored inside vectors and matrices
+   * @LAmatrix, @LAvector = types of matrix and vector, with the same requirements as
+   * for LinearCG. Additionally LAvector must provide operator[] and size().
+   *
+   * A has to be hermitian and positive definite. The initial guess is x_k = 0.
+   */
+  template <class Float, class T, class LAmatrix, class LAvector> class MultishiftCG {
+  private:
+    std::vector<LAvector> x; // solutions
+    size_t num_iter = 0; // number of iterations (= matrix-vector products)
+    bool solved = false;
+
+  public:
+    MultishiftCG() {}
+    ~MultishiftCG() {}
+
+    /**
+     * @brief solve the shifted systems
+     *
+     * @param A matrix
+     * @param b source
+     * @param shifts sigma_k >= 0
+     * @param tol tolerance on the residual norm of each shifted system
+     * @param verbosity verbosity level
+     */
+    void solve(const LAmatrix &A,
+               const LAvector &b,
+               const std::vector<Float> &shifts,
+               const Float &tol = 1e-15,
+               const size_t &verbosity = 0) {
+      const size_t ns = shifts.size();
+      const size_t n = b.size();
+
+      LAvector r = b; // residual of the unshifted system
+      LAvector p = b; // search direction of the unshifted system
+      LAvector zero = b;
+#pragma omp parallel for
+      for (size_t i = 0; i < n; i++) {
+        zero[i] = 0.0;
+      }
+      x.assign(ns, zero);
+      std::vector<LAvector> ps(ns, b); // search directions of the shifted systems
+
+      // zeta_k: ratio of the shifted and unshifted residuals at the current and
+      // previous iteration
+      std::vector<Float> zeta(ns, 1.0), zeta_old(ns, 1.0);
+      std::vector<bool> active(ns, true);
+
+      Float rr = r.dot(r).real();
+      Float alpha_old = 1.0, beta_old = 0.0;
+
+      num_iter = 0;
+      size_t n_active = ns;
+      while (n_active > 0) {
+        const LAvector Ap = A * p;
+        const Float alpha = rr / p.dot(Ap).real();
+
+        // shifted coefficients from the unshifted ones
+        std::vector<Float> zeta_new(ns), alpha_s(ns);
+        for (size_t k = 0; k < ns; k++) {
+          if (!active[k]) {
+            continue;
+          }
+          zeta_new[k] = zeta[k] * zeta_old[k] * alpha_old /
+                        (alpha * beta_old * (zeta_old[k] - zeta[k]) +
+                         zeta_old[k] * alpha_old * (1.0 + shifts[k] * alpha));
+          alpha_s[k] = alpha * zeta_new[k] / zeta[k];
+        }
+
+#pragma omp parallel for
+        for (size_t i = 0; i < n; i++) {
+          r[i] -= alpha * Ap[i];
+          for (size_t k = 0; k < ns; k++) {
+            if (active[k]) {
+              x[k][i] += alpha_s[k] * ps[k][i];
+            }
+          }
+        }
+
+        const Float rr_new = r.dot(r).real();
+        const Float beta = rr_new / rr;
+
+#pragma omp parallel for
+        for (size_t i = 0; i < n; i++) {
+          p[i] = r[i] + beta * p[i];
+          for (size_t k = 0; k < ns; k++) {
+            if (active[k]) {
+              const Float beta_s = beta * (zeta_new[k] / zeta[k]) * (zeta_new[k] / zeta[k]);
+              ps[k][i] = zeta_new[k] * r[i] + beta_s * ps[k][i];
+            }
+          }
+        }
+
+        num_iter += 1;
+        const Float r_norm = std::sqrt(rr_new);
+        for (size_t k = 0; k < ns; k++) {
+          if (!active[k]) {
+            continue;
+          }
+          zeta_old[k] = zeta[k];
+          zeta[k] = zeta_new[k];
+          // residual of the shifted system: r_k = zeta_k * r
+          if (std::abs(zeta[k]) * r_norm <= tol) {
+            active[k] = false;
+            n_active--;
+          }
+        }
+        if (verbosity > 1) {
+          std::cout << "Iteration: " << num_iter << " residual rk.norm() = " << r_norm
+                    << " active shifts: " << n_active << "\n";
+        }
+        if (!(rr_new > 0.0)) { // exact solution of the unshifted system
+          break;
+        }
+
+        rr = rr_new;
+        alpha_old = alpha;
+        beta_old = beta;
+      }
+
+      if (verbosity > 0) {
+        std::cout << "Multi-shift CG: " << ns << " shifts solved in " << num_iter
+                  << " iterations\n";
+      }
+      solved = true;
+    }
+
+    std::vector<LAvector> get_solutions() const {
+      if (!solved) {
+        std::cerr << "Error: the system has not been solved yet.\n";
+        std::abort();
+      }
+      return x;
+    }
+
+    size_t get_iterations() const { return num_iter; }
+
+  }; // class MultishiftCG
+
+} // namespace CG
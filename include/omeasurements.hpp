@@ -7,17 +7,22 @@
 
 #pragma once
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <vector>
 
+#include "cooling.hh"
 #include "flat-gradient_flow.hh"
 #include "glueballs.hpp"
 #include "io.hh"
+#include "link_integral.hh"
 #include "links.hpp"
+#include "multilevel.hh"
 #include "operators.hpp"
 #include "parameters.hh"
+#include "polyakov_loop.hh"
 #include "propagator.hpp"
 #include "smearape.hh"
 #include "wilsonloop.hh"
@@ -35,11 +40,14 @@ namespace omeasurements {
    * @param U gauge config
    * @param i configurationn index
    * @param conf_dir
+   * @param Ubar if given, one-link integrals of the temporal links (see
+   * link_integral.hh)
    */
   template <class Group>
   void meas_wilson_loop(const gaugeconfig<Group> &U,
                         const size_t &i,
-                        const std::string &res_dir) {
+                        const std::string &res_dir,
+                        const std::vector<typename accum_type<Group>::type> *Ubar = nullptr) {
     std::ostringstream os;
     os << res_dir + "/wilsonloop.";
     auto prevw = os.width(6);
@@ -48,13 +56,49 @@ namespace omeasurements {
     os.width(prevw);
     os.fill(prevf);
     os << ".dat" << std::ends;
-    compute_all_loops(U, os.str());
+    compute_all_loops(U, os.str(), Ubar);
 
     return;
   }
 
+  /**
+   * @brief compute and print the spatial average of the Polyakov loop
+   * Writes Re tr P, averaged over the spatial sites, to res_dir/polyakovloop.<i>.dat
+   *
+   * @param U gauge config
+   * @param i configuration index
+   * @param res_dir
+   * @param Ubar if given, one-link integrals of the temporal links (see
+   * link_integral.hh)
+   */
+  template <class Group>
+  void meas_polyakov_loop(const gaugeconfig<Group> &U,
+                          const size_t &i,
+                          const std::string &res_dir,
+                          const std::vector<typename accum_type<Group>::type> *Ubar = nullptr) {
+    std::ostringstream os;
+    os << res_dir + "/polyakovloop.";
+    auto prevw = os.width(6);
+    auto prevf = os.fill('0');
+    os << i;
+    os.width(prevw);
+    os.fill(prevf);
+    os << ".dat";
+
+    std::ofstream ofs(os.str(), std::ios::out);
+    ofs << "P\n";
+    ofs << std::scientific << std::setprecision(16)
+        << polyakov_loop_spatial_average(U, Ubar) << "\n";
+    return;
+  }
+
   /**
    * @brief compute and print the gradient flow of a given configuration
+   * If the checkpoint res_dir/gradient_flow.<i>.ckpt of an earlier flow of the same
+   * configuration (same links and index i) exists, the flow continues from there and the
+   * output is appended (tstart is then ignored). Without checkpoint and with
+   * tstart > eps the configuration flowed to tstart is read from
+   * res_dir/gradient_flow.<i>_t<tstart>.conf.
    *
    * @tparam Group
    * @tparam sparams struct containing info on computation and output
@@ -81,12 +125,177 @@ namespace omeasurements {
     os.width(prevw);
     os.fill(prevf);
 
+    // resume from the checkpoint of a previous flow of this configuration, if any
     gaugeconfig<Group> V = U;
-    if (tstart > eps) {
+    flat_spacetime::flow_state state;
+    state.origin = flat_spacetime::flow_checkpoint::fingerprint(U, i);
+    if (flat_spacetime::load_flow_checkpoint(os.str() + ".ckpt", V, state, state.origin)) {
+      tstart = state.t;
+      const bool scales_found = !std::isnan(state.t0) && !std::isnan(state.w0) &&
+                                tstart >= std::max(state.t0, state.w0 * state.w0) +
+                                             S.gradient_flow.scale_margin - eps / 2.0;
+      if (tstart >= tmax - eps / 2.0 || (S.gradient_flow.scale_setting && scales_found)) {
+        std::cout << "## gradient flow of configuration " << i << " done until t=" << tstart
+                  << "\n";
+        return;
+      }
+      std::cout << "## resuming the gradient flow of configuration " << i
+                << " from t=" << tstart << "\n";
+    } else if (tstart > eps) {
       V.load(os.str() + "_t" + std::to_string(tstart) + ".conf");
     }
-    flat_spacetime::gradient_flow(V, os.str(), tmax, eps, pparams.xi, tstart, save_conf);
+    if (S.gradient_flow.scale_setting) {
+      const flat_spacetime::flow_scales sc = flat_spacetime::gradient_flow_scale(
+        V, os.str(), tmax, eps, pparams.xi, tstart, save_conf, S.gradient_flow.t0_ref,
+        S.gradient_flow.w0_ref, S.gradient_flow.scale_margin, &state);
+
+      // one line per configuration, NA if the scale was not reached before tmax
+      // (configurations flowed at the same time append one at a time)
+#pragma omp critical(flow_scale_record)
+      {
+        const std::string record = res_dir + "/flow_scale.data";
+        const bool new_file = !fsys::exists(record);
+        std::ofstream ofs(record, std::ios::app);
+        if (new_file) {
+          ofs << "i t0 w0 tstop\n";
+        }
+        auto print_scale = [&](const double &x) {
+          if (std::isnan(x)) {
+            ofs << " NA";
+          } else {
+            ofs << " " << x;
+          }
+        };
+        ofs << std::scientific << std::setprecision(16) << i;
+        print_scale(sc.t0);
+        print_scale(sc.w0);
+        ofs << " " << sc.tstop << "\n";
+      }
+    } else if (S.gradient_flow.adaptive) {
+      flat_spacetime::gradient_flow_adaptive(V, os.str(), tmax, eps, pparams.xi, tstart,
+                                             save_conf, S.gradient_flow.tolerance,
+                                             S.gradient_flow.measure_times, &state);
+    } else {
+      flat_spacetime::gradient_flow(V, os.str(), tmax, eps, pparams.xi, tstart, save_conf,
+                                    S.gradient_flow.measure_times, &state);
+    }
+
+    return;
+  }
+
+  /**
+   * @brief plaquette, energy density and topological charge after cooling
+   * Writes the line "n P E Q" after the cooling sweeps n in S.cooling.measure_sweeps
+   * (all sweeps if empty) to res_dir/cooling.<i>, with the observables of
+   * gradient_flow() (P normalised to d(d-1)/2 for the unit configuration, E and Q
+   * from the clover field). The first line (n=0) is the configuration before cooling.
+   *
+   * @param U gauge config
+   * @param i configuration index
+   */
+  template <class Group, class sparams>
+  void meas_cooling(const gaugeconfig<Group> &U,
+                    const size_t &i,
+                    const global_parameters::physics &pparams,
+                    const sparams &S) {
+    std::ostringstream os;
+    os << S.res_dir + "/cooling.";
+    auto prevw = os.width(6);
+    auto prevf = os.fill('0');
+    os << i;
+    os.width(prevw);
+    os.fill(prevf);
+
+    const std::vector<size_t> &ms = S.cooling.measure_sweeps;
+    const double den = U.getVolume() * double(U.getNc());
+    flat_spacetime::clover_field<Group> G;
+
+    std::ofstream ofs(os.str(), std::ios::out);
+    ofs << "n P E Q\n";
+    ofs << std::scientific << std::setprecision(16);
+    auto print = [&](const size_t &n, const gaugeconfig<Group> &V) {
+      const flat_spacetime::clover_observables obs = G.observables(V);
+      ofs << n << " " << obs.P / den << " " << obs.E << " " << obs.Q << "\n";
+    };
+
+    gaugeconfig<Group> V = U;
+    print(0, V);
+    for (size_t n = 1; n <= S.cooling.n_sweeps; n++) {
+      flat_spacetime::cooling_sweep(V, S.cooling.alpha, pparams.xi, pparams.anisotropic);
+      if (ms.empty() || std::find(ms.begin(), ms.end(), n) != ms.end()) {
+        print(n, V);
+      }
+    }
+    return;
+  }
+
+  /**
+   * @brief Polyakov loop correlator and Wilson loops with the multilevel algorithm
+   * Writes the line "r P(r) W(r,thickness) W(r,2*thickness) ..." for r = 1..rmax to
+   * res_dir/multilevel.<i>. P(r) is the correlator of the undivided traces (N_c^2 on the
+   * unit configuration), the W are divided by N_c (1 on the unit configuration), see
+   * multilevel::compute_multilevel().
+   * The random number generators of the sub-updates are seeded from S.seed and i.
+   *
+   * @param U gauge config
+   * @param i configuration index
+   */
+  template <class Group, class sparams>
+  void meas_multilevel(const gaugeconfig<Group> &U,
+                       const size_t &i,
+                       const global_parameters::physics &pparams,
+                       const sparams &S) {
+    std::ostringstream os;
+    os << S.res_dir + "/multilevel.";
+    auto prevw = os.width(6);
+    auto prevf = os.fill('0');
+    os << i;
+    os.width(prevw);
+    os.fill(prevf);
+
+    const global_parameters::measure_multilevel &ml = S.multilevel;
+    const multilevel::result res = multilevel::compute_multilevel(
+      U, ml.thickness, ml.rmax, ml.n_sub, ml.n_sweeps, ml.n_hit, ml.delta,
+      S.seed + i * U.getLt(), pparams.xi, pparams.anisotropic);
+
+    std::ofstream ofs(os.str(), std::ios::out);
+    ofs << "## acceptance " << res.acceptance << "\n";
+    ofs << "r P";
+    for (size_t k = 1; k <= res.wilson.size(); k++) {
+      ofs << " W" << k * ml.thickness;
+    }
+    ofs << "\n";
+    ofs << std::scientific << std::setprecision(16);
+    for (size_t r = 1; r <= ml.rmax; r++) {
+      ofs << r << " " << res.polyakov[r - 1];
+      for (size_t k = 0; k < res.wilson.size(); k++) {
+        ofs << " " << res.wilson[k][r - 1];
+      }
+      ofs << "\n";
+    }
+    return;
+  }
 
+  /**
+   * @brief gradient flow of a batch of configurations, see meas_gradient_flow()
+   * Each configuration is flowed by a single thread and the threads work on different
+   * configurations. For small and medium lattices this avoids the overhead of the
+   * parallel regions in each step of the flow, which then run on one thread (nested
+   * parallelism is assumed to be disabled, the OpenMP default).
+   * The batch should contain at least as many configurations as threads.
+   *
+   * @param U gauge configurations
+   * @param idx configuration indices
+   */
+  template <class Group, class sparams>
+  void meas_gradient_flow_batch(const std::vector<gaugeconfig<Group>> &U,
+                                const std::vector<size_t> &idx,
+                                const global_parameters::physics &pparams,
+                                const sparams &S) {
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t k = 0; k < U.size(); k++) {
+      meas_gradient_flow(U[k], idx[k], pparams, S);
+    }
     return;
   }
 
@@ -374,100 +583,124 @@ namespace omeasurements {
    * -(0,1) loops for temporal, (1,2) and (1,3) loops for spatial
    * writes one line per configuration into the resultfiles.
    * At the moment, measurements are implemented for dim=3,4.
+   * The loops are taken from nonplanar_wilsonloops().
    * @param U holds the gauge-configuration whose loops are measured
    * @param pparams holds information about the size of the lattice
    * @param sizeWloops: maximum extent up to which loops are measured
    * @param filenames: files into which the results of the measurements are written
    * @param i: index of the configuration
+   * @param Ubar: if given, one-link integrals of the temporal links (see
+   * link_integral.hh)
    * **/
   template <class Group>
-  void meas_loops_planar_pot(const gaugeconfig<Group> &U,
-                             const global_parameters::physics &pparams,
-                             const double &sizeWloops,
-                             const std::string &filename_coarse,
-                             const std::string &filename_fine,
-                             const size_t &i) {
-    double loop;
+  void meas_loops_planar_pot(
+    const gaugeconfig<Group> &U,
+    const global_parameters::physics &pparams,
+    const double &sizeWloops,
+    const std::string &filename_coarse,
+    const std::string &filename_fine,
+    const size_t &i,
+    const std::vector<typename accum_type<Group>::type> *Ubar = nullptr) {
+    if (pparams.ndims != 3 && pparams.ndims != 4) {
+      return;
+    }
+    const size_t tmax = pparams.Lt * sizeWloops;
+    const size_t xmax = pparams.Lx * sizeWloops;
+    const size_t ymax = pparams.Ly * sizeWloops;
     std::ofstream resultfile;
-    //~ //calculate wilsonloops for potential
-    if (pparams.ndims == 4) {
-      resultfile.open(filename_fine, std::ios::app);
-      for (size_t t = 1; t <= pparams.Lt * sizeWloops; t++) {
-        for (size_t x = 1; x <= pparams.Lx * sizeWloops; x++) {
-          loop = wilsonloop_non_planar(U, {t, x, 0, 0});
-          resultfile << std::setw(14) << std::scientific << loop / U.getVolume() << "  ";
-        }
-      }
-      resultfile << i;
-      resultfile << std::endl;
-      resultfile.close();
-
-      resultfile.open(filename_coarse, std::ios::app);
-      for (size_t y = 1; y <= pparams.Ly * sizeWloops; y++) {
-        for (size_t x = 1; x <= pparams.Lx * sizeWloops; x++) {
-          loop = wilsonloop_non_planar(U, {0, x, y, 0});
-          loop += wilsonloop_non_planar(U, {0, x, 0, y});
-          resultfile << std::setw(14) << std::scientific << loop / U.getVolume() / 2.0
-                     << "  ";
-        }
+
+    // W(x, t, y=z=0), the direction of y does not matter
+    const auto fine = nonplanar_wilsonloops(U, 1, 2, tmax, xmax, 0, Ubar);
+    resultfile.open(filename_fine, std::ios::app);
+    for (size_t t = 1; t <= tmax; t++) {
+      for (size_t x = 1; x <= xmax; x++) {
+        resultfile << std::setw(14) << std::scientific << fine[t][x][0] / U.getVolume()
+                   << "  ";
       }
-      resultfile << i;
-      resultfile << std::endl;
-      resultfile.close();
     }
-    if (pparams.ndims == 3) {
-      resultfile.open(filename_fine, std::ios::app);
-      for (size_t t = 1; t <= pparams.Lt * sizeWloops; t++) {
-        for (size_t x = 1; x <= pparams.Lx * sizeWloops; x++) {
-          loop = wilsonloop_non_planar(U, {t, x, 0});
-          //~ loop  += wilsonloop_non_planar(U, {t, 0, x});
-          resultfile << std::setw(14) << std::scientific << loop / U.getVolume() << "  ";
+    resultfile << i;
+    resultfile << std::endl;
+    resultfile.close();
+
+    // W(x, y, t=z=0), in 4d averaged with W(x, z, t=y=0)
+    auto coarse = nonplanar_wilsonloops(U, 1, 2, 0, xmax, ymax);
+    if (pparams.ndims == 4) {
+      const auto coarse_z = nonplanar_wilsonloops(U, 1, 3, 0, xmax, ymax);
+      for (size_t x = 1; x <= xmax; x++) {
+        for (size_t y = 1; y <= ymax; y++) {
+          coarse[0][x][y] = (coarse[0][x][y] + coarse_z[0][x][y]) / 2.0;
         }
       }
-      resultfile << i;
-      resultfile << std::endl;
-      resultfile.close();
-
-      resultfile.open(filename_coarse, std::ios::app);
-      for (size_t y = 1; y <= pparams.Ly * sizeWloops; y++) {
-        for (size_t x = 1; x <= pparams.Lx * sizeWloops; x++) {
-          loop = wilsonloop_non_planar(U, {0, x, y});
-          //~ loop += wilsonloop_non_planar(U, {0, y, x});
-          resultfile << std::setw(14) << std::scientific << loop / U.getVolume() << "  ";
-        }
+    }
+    resultfile.open(filename_coarse, std::ios::app);
+    for (size_t y = 1; y <= ymax; y++) {
+      for (size_t x = 1; x <= xmax; x++) {
+        resultfile << std::setw(14) << std::scientific << coarse[0][x][y] / U.getVolume()
+                   << "  ";
       }
-      resultfile << i;
-      resultfile << std::endl;
-      resultfile.close();
     }
+    resultfile << i;
+    resultfile << std::endl;
+    resultfile.close();
   }
 
   /**
    * measures the nonplanar wilson loops in temporal and spatial direction
    * writes one line per configuration into the resultfiles.
-   * At the moment, measurements are implemented for dim=3.
+   * At the moment, measurements are implemented for dim=3,4. In 4 dimensions the loops
+   * are averaged over the spatial planes (1,2), (1,3) and (2,3).
    * all possible loops (t,x,y) with x,y <=min(4, Lx), t<Lt*sizeWloops are measured.
+   * The loops are taken from nonplanar_wilsonloops().
    * @param U holds the gauge-configuration whose loops are measured
    * @param pparams holds information about the size of the lattice
    * @param sizeWloops: maximum extent up to which loops are measured
    * @param filenames: files into which the results of the measurements are written
    * @param i: index of the configuration
+   * @param Ubar: if given, one-link integrals of the temporal links (see
+   * link_integral.hh)
    * **/
   template <class Group>
-  void meas_loops_nonplanar_pot(const gaugeconfig<Group> &U,
-                                const global_parameters::physics &pparams,
-                                const double &sizeWloops,
-                                const std::string &filename_nonplanar,
-                                const size_t &i) {
-    double loop;
+  void meas_loops_nonplanar_pot(
+    const gaugeconfig<Group> &U,
+    const global_parameters::physics &pparams,
+    const double &sizeWloops,
+    const std::string &filename_nonplanar,
+    const size_t &i,
+    const std::vector<typename accum_type<Group>::type> *Ubar = nullptr) {
+    if (pparams.ndims != 3 && pparams.ndims != 4) {
+      return;
+    }
+    const size_t tmax = pparams.Lt * sizeWloops;
+    const size_t maxsizenonplanar = (pparams.Lx < 4) ? pparams.Lx : 4;
+
+    std::vector<std::vector<std::vector<double>>> loops;
+    size_t n_planes = 0;
+    for (size_t mu = 1; mu < pparams.ndims - 1; mu++) {
+      for (size_t nu = mu + 1; nu < pparams.ndims; nu++) {
+        const auto loops_plane =
+          nonplanar_wilsonloops(U, mu, nu, tmax, maxsizenonplanar, maxsizenonplanar, Ubar);
+        if (n_planes == 0) {
+          loops = loops_plane;
+        } else {
+          for (size_t t = 0; t <= tmax; t++) {
+            for (size_t x = 0; x <= maxsizenonplanar; x++) {
+              for (size_t y = 0; y <= maxsizenonplanar; y++) {
+                loops[t][x][y] += loops_plane[t][x][y];
+              }
+            }
+          }
+        }
+        n_planes++;
+      }
+    }
+
     std::ofstream resultfile;
-    size_t maxsizenonplanar = (pparams.Lx < 4) ? pparams.Lx : 4;
     resultfile.open(filename_nonplanar, std::ios::app);
-    for (size_t t = 0; t <= pparams.Lt * sizeWloops; t++) {
+    for (size_t t = 0; t <= tmax; t++) {
       for (size_t x = 0; x <= maxsizenonplanar; x++) {
         for (size_t y = 0; y <= maxsizenonplanar; y++) {
-          loop = wilsonloop_non_planar(U, {t, x, y});
-          resultfile << std::setw(14) << std::scientific << loop / U.getVolume() << "  ";
+          resultfile << std::setw(14) << std::scientific
+                     << loops[t][x][y] / U.getVolume() / n_planes << "  ";
         }
       }
     }
@@ -0,0 +1,47 @@
+/**
+ * @file parallel_reduction.hh
+ * @brief deterministic parallel sums
+ *
+ * OpenMP reductions combine the partial sums of the threads in an unspecified order,
+ * so the result changes with the number of threads at the level of rounding errors.
+ * Here the index range is split into blocks of fixed size, the blocks are summed in
+ * parallel and the partial sums are added in a fixed order. The result is then the
+ * same for any number of threads.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace parallel_reduction {
+
+  const size_t block_size = 4096; // number of terms summed by one task
+
+  /**
+   * @brief sum of f(i) for i = 0, ..., N-1
+   *
+   * @tparam T type of the result, T(0) has to be the zero element
+   * @param N number of terms
+   * @param f callable returning the i-th term
+   */
+  template <typename T, class F> T deterministic_sum(const size_t &N, const F &f) {
+    const size_t n_blocks = (N + block_size - 1) / block_size;
+    std::vector<T> partial(n_blocks, T(0));
+#pragma omp parallel for
+    for (size_t b = 0; b < n_blocks; b++) {
+      const size_t end = std::min(N, (b + 1) * block_size);
+      T s = T(0);
+      for (size_t i = b * block_size; i < end; i++) {
+        s += f(i);
+      }
+      partial[b] = s;
+    }
+    T res = T(0);
+    for (size_t b = 0; b < n_blocks; b++) {
+      res += partial[b];
+    }
+    return res;
+  }
+
+} // namespace parallel_reduction
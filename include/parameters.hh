@@ -14,6 +14,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 namespace global_parameters {
 
@@ -66,7 +67,32 @@ namespace global_parameters {
     double epsilon = 0.01; // integration step of the flow equations
     double tmax = 1.0; // tmax for gradient flow
     double tstart = 0.0; // 1st value of the flow time
-    bool save_conf = true; // save configuration at the end of the evolution
+    bool save_conf = true; // write the flow checkpoint at the end of the evolution
+    std::vector<double> measure_times = {}; // flow times of the measurements, {}: all
+    bool adaptive = false; // adaptive step size with error control
+    double tolerance = 1e-4; // maximal error per step of the adaptive integration
+    bool scale_setting = false; // stop the flow once t0 and w0 are found
+    double t0_ref = 0.3; // t^2 E(t) at t = t0
+    double w0_ref = 0.3; // t d/dt(t^2 E(t)) at t = w0^2
+    double scale_margin = 0.1; // flow time after both crossings before stopping
+    size_t batch = 1; // configurations flowed at the same time (offline measurements)
+  };
+
+  struct measure_cooling {
+    bool measure_it = false; // whether to measure after cooling or not
+    size_t n_sweeps = 20; // number of cooling sweeps
+    double alpha = 1.0; // relaxation parameter: 1 standard, < 1 under-, > 1 over-relaxed
+    std::vector<size_t> measure_sweeps = {}; // sweeps after which to measure, {}: all
+  };
+
+  struct measure_multilevel {
+    bool measure_it = false; // whether to do the multilevel measurement or not
+    size_t thickness = 2; // time slices per slab, must divide Lt
+    size_t rmax = 4; // largest spatial distance
+    size_t n_sub = 20; // slab configurations per average
+    size_t n_sweeps = 1; // slab sweeps between two slab configurations
+    size_t n_hit = 10; // Metropolis hits per link
+    double delta = 0.3; // size of the Metropolis steps
   };
 
   /* optional parameters for the measure program the in U(1) theory */
@@ -86,6 +112,10 @@ namespace global_parameters {
 
     size_t nstep = 1; // measure each nstep config
     bool Wloop = false; // whether to measure the Wilson loops or not
+    bool Ploop = false; // whether to measure the Polyakov loop or not
+    // replace the temporal links in the Wilson loops (Wloop and potential) and in the
+    // Polyakov loop by their one-link integrals, see link_integral.hh. Pure gauge only
+    bool link_integral = false;
 
     std::string conf_dir = "./"; // directory where gauge configurations are stored
     std::string res_dir = "./"; // directory where results from measurements for
@@ -97,7 +127,8 @@ namespace global_parameters {
              // separate files. Only available for ndims=3,4
     bool potentialnonplanar =
       false; // The loops W(x, t, y) are measured up to x, y=min(4, lattice extent), t <=
-             // Lt * sizeloops and saved to one file. Only available for ndim=3
+             // Lt * sizeloops and saved to one file. Only available for ndim=3,4, in 4
+             // dimensions averaged over the three spatial planes
     bool append = false; // are measurements for potential appended to an existing file,
                          // or should it be overwritten?
     double sizeWloops =
@@ -123,6 +154,8 @@ namespace global_parameters {
 
     measure_glueball glueball; // struct for the measure of the glueball
     measure_gradient_flow gradient_flow; // struct for the measure of the gradient flow
+    measure_cooling cooling; // struct for the measure of Q and E after cooling
+    measure_multilevel multilevel; // struct for the multilevel Wilson/Polyakov loops
   };
 
   /* Optional parameters for the hmc the in U(1) theory */
@@ -150,11 +183,47 @@ namespace global_parameters {
     // leapfrog, lp_leapfrog, omf4, lp_omf4, Euler, RUTH, omf2
     std::string integrator = "leapfrog";
 
+    // autotuning of the integrator (see md_autotune.hh)
+    bool autotune = false; // tune integrator, n_steps and omf2 lambda during thermalization
+    size_t n_therm_tune = 0; // trajectories from the start of the chain before tuning
+    size_t n_tune = 10; // trial trajectories per measured integrator setting
+    double target_acceptance = 0.8; // acceptance rate the tuned setup has to reach
+    std::vector<std::string> tune_integrators = {"leapfrog", "omf2", "omf4"}; // candidates
+
+    // Kramers (generalised HMC) update, see kramers_md_update.hh
+    bool kramers = false; // k_max short trajectories with partial momentum refresh
+    double kramers_gamma = 1.0; // friction: the momenta keep exp(-gamma*tau) of their value
+    size_t kramers_kmax = 1; // trajectories per step of the Markov chain
+
+    // Lyapunov exponent of the MD evolution, see lyapunov.hh
+    bool lyapunov = false; // measure it on the configurations of the chain
+    size_t lyapunov_nstep = 1; // measure every lyapunov_nstep trajectories
+    size_t lyapunov_copies = 4; // number of perturbed copies of the configuration
+    double lyapunov_delta = 1e-8; // size of the perturbation of the links
+    size_t lyapunov_steps = 100; // number of MD steps of the evolution
+
     // fermions stuff (operators)
     std::string solver = "CG"; // Type of solver: CG, BiCGStab
     double tolerance_cg = 1e-10; // Tolerance for the solver for the dirac operator
     size_t solver_verbosity = 0; // Verbosity for the solver for the dirac operator
     size_t seed_pf = 97234719; // Seed for the evaluation of the fermion determinant
+    size_t n_chrono = 0; // solutions kept for the chronological initial guess, 0: none
+    // solver tolerances of all the pseudo-fermion monomials, 0: monomial's own tolerance
+    double tolerance_action = 0.; // heatbath and accept/reject step
+    double tolerance_force = 0.; // MD force, defaults to the action tolerance
+    bool scale_tolerance_force = false; // force tolerance multiplied by dtau^2
+    // Hasenbusch mass preconditioning: intermediate masses m_1 > ... > m_K > m0 and
+    // solver tolerances of det(m_1), det(m_2)/det(m_1), ..., det(m0)/det(m_K)
+    std::vector<double> hasenbusch_masses = {};
+    std::vector<double> hasenbusch_tolerances = {};
+
+    // rational HMC: staggered determinant det(D*D^{\dagger})^{alpha}
+    bool rhmc = false; // true when the action contains the RHMC monomial
+    double rhmc_alpha = 0.5; // power of the determinant, 0 < alpha < 1
+    double rhmc_tolerance_ra = 1e-10; // relative error of the rational approximation
+    double rhmc_tolerance_cg = 1e-10; // tolerance of the multi-shift CG
+    size_t rhmc_solver_verbosity = 0; // verbosity of the multi-shift CG
+    size_t rhmc_seed_pf = 98534428; // seed of the RHMC pseudo-fermions
 
     // configurations filenames
     std::string conf_dir = "."; // Output directory
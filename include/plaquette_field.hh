@@ -0,0 +1,190 @@
+/**
+ * @file plaquette_field.hh
+ * @brief cache of the oriented plaquettes P_{mu nu}(x), mu < nu, of a configuration
+ *
+ * P_{mu nu}(x) = U_mu(x) U_nu(x+mu) U_mu(x+nu)^{\dagger} U_nu(x)^{\dagger}
+ *
+ * The gauge action, the plaquette energy and the gauge force are all built from the
+ * same products of links. The field is computed once per state of the configuration,
+ * identified by its revision stamp (see gaugeconfig::getRevision()), and then reused:
+ * during a trajectory the plaquettes computed for the force at the last MD step give
+ * the final action and, after the accept/reject step, the plaquette energy.
+ * Two states are kept, such that the field of the starting configuration survives the
+ * trajectory and is still available after a reject.
+ */
+
+#pragma once
+
+#include "accum_type.hh"
+#include "adjointfield.hh"
+#include "gaugeconfig.hh"
+#include "geometry.hh"
+#include "parallel_reduction.hh"
+#include "su2.hh"
+#include "u1.hh"
+
+#include <array>
+#include <vector>
+
+namespace flat_spacetime {
+
+  template <class Group> class plaquette_field {
+  public:
+    plaquette_field() {}
+
+    /**
+     * @brief plaquettes of U, recomputed only if U has changed since the last call
+     * Element (s, p) is stored at s*n_planes + p, where s is the site index and p
+     * labels the plane mu < nu (see plane()).
+     */
+    const std::vector<Group> &get(const gaugeconfig<Group> &U) {
+      n_calls++;
+      for (size_t k = 0; k < entries.size(); k++) {
+        if (entries[k].revision == U.getRevision() && entries[k].P.size() > 0) {
+          entries[k].last_use = n_calls;
+          return entries[k].P;
+        }
+      }
+      // replace the entry used least recently
+      entry &e =
+        (entries[0].last_use <= entries[1].last_use) ? entries[0] : entries[1];
+      compute(U, e.P);
+      e.revision = U.getRevision();
+      e.last_use = n_calls;
+      return e.P;
+    }
+
+    /**
+     * @brief \sum_x \sum_{mu<nu} eta_{mu nu} Re(Tr(P_{mu nu}(x)))
+     * with eta_{0i}=1/xi and eta_{ij}=xi when anisotropic. If spatial_only, only the
+     * planes with mu, nu > 0 are summed. The sum is independent of the number of
+     * threads.
+     */
+    double retr_sum(const gaugeconfig<Group> &U,
+                    const double &xi = 1.0,
+                    const bool &anisotropic = false,
+                    const bool &spatial_only = false) {
+      const std::vector<Group> &P = (*this).get(U);
+      const size_t d = U.getndims();
+      const size_t np = n_planes(d);
+      return parallel_reduction::deterministic_sum<double>(
+        U.getVolume(), [&](const size_t &s) {
+          double res = 0.;
+          for (size_t mu = spatial_only; mu < d - 1; mu++) {
+            for (size_t nu = mu + 1; nu < d; nu++) {
+              res += eta(mu, nu, xi, anisotropic) * retrace(P[s * np + plane(mu, nu, d)]);
+            }
+          }
+          return res;
+        });
+    }
+
+    /**
+     * @brief deriv += fac * beta/N_c * d/dU of the Wilson action
+     * For each link the staples are replaced by the 2(d-1) plaquettes starting with
+     * U_mu(x): P_{mu nu}(x) is read from the cache, the plaquette in the -nu direction is
+     * U_nu(x-nu)^{\dagger} P_{mu nu}(x-nu)^{\dagger} U_nu(x-nu).
+     */
+    template <typename Float>
+    void add_force(adjointfield<Float, Group> &deriv,
+                   const gaugeconfig<Group> &U,
+                   const Float &fac,
+                   const double &xi = 1.0,
+                   const bool &anisotropic = false) {
+      typedef typename accum_type<Group>::type accum;
+      const std::vector<Group> &P = (*this).get(U);
+      const size_t d = U.getndims();
+      const size_t np = n_planes(d);
+      const geometry g(U.getLx(), U.getLy(), U.getLz(), U.getLt());
+      const double c = fac * U.getBeta() / double(U.getNc());
+      const size_t V = U.getVolume();
+
+#pragma omp parallel for
+      for (size_t s = 0; s < V; s++) {
+        const std::array<int, 4> x = coordinates(g, s);
+        for (size_t mu = 0; mu < d; mu++) {
+          accum S;
+          for (size_t nu = 0; nu < d; nu++) {
+            if (nu == mu) {
+              continue;
+            }
+            std::array<int, 4> y = x;
+            y[nu]--;
+            const size_t sy = g.getIndex(y[0], y[1], y[2], y[3]);
+            const Group &Uy = U[sy * d + nu];
+            // P_{mu nu}(x) and P_{mu nu}(x-nu)^{\dagger} from the planes mu < nu
+            const Group Pf =
+              (mu < nu) ? P[s * np + plane(mu, nu, d)] : P[s * np + plane(nu, mu, d)].dagger();
+            const Group Qb = (mu < nu) ? P[sy * np + plane(mu, nu, d)].dagger()
+                                       : P[sy * np + plane(nu, mu, d)];
+            const double e = eta(mu, nu, xi, anisotropic);
+            S += e * Pf;
+            S += e * (Uy.dagger() * Qb * Uy);
+          }
+          deriv[s * d + mu] += c * get_deriv<double>(S);
+        }
+      }
+      return;
+    }
+
+  private:
+    struct entry {
+      size_t revision = 0; // stamp of the configuration the plaquettes belong to
+      size_t last_use = 0;
+      std::vector<Group> P;
+    };
+    std::array<entry, 2> entries;
+    size_t n_calls = 0;
+
+    static size_t n_planes(const size_t &d) { return d * (d - 1) / 2; }
+
+    // index of the plane mu < nu: (0,1), (0,2), ..., (0,d-1), (1,2), ...
+    static size_t plane(const size_t &mu, const size_t &nu, const size_t &d) {
+      return mu * (2 * d - mu - 1) / 2 + (nu - mu - 1);
+    }
+
+    static double
+    eta(const size_t &mu, const size_t &nu, const double &xi, const bool &anisotropic) {
+      if (!anisotropic) {
+        return 1.0;
+      }
+      return ((mu == 0) ^ (nu == 0)) ? 1.0 / xi : xi;
+    }
+
+    static std::array<int, 4> coordinates(const geometry &g, size_t s) {
+      std::array<int, 4> x;
+      x[3] = s % g.getLz();
+      s /= g.getLz();
+      x[2] = s % g.getLy();
+      s /= g.getLy();
+      x[1] = s % g.getLx();
+      x[0] = s / g.getLx();
+      return x;
+    }
+
+    static void compute(const gaugeconfig<Group> &U, std::vector<Group> &P) {
+      const size_t d = U.getndims();
+      const size_t np = n_planes(d);
+      const geometry g(U.getLx(), U.getLy(), U.getLz(), U.getLt());
+      const size_t V = U.getVolume();
+      P.resize(V * np);
+#pragma omp parallel for
+      for (size_t s = 0; s < V; s++) {
+        const std::array<int, 4> x = coordinates(g, s);
+        for (size_t mu = 0; mu < d - 1; mu++) {
+          std::array<int, 4> xmu = x;
+          xmu[mu]++;
+          const size_t smu = g.getIndex(xmu[0], xmu[1], xmu[2], xmu[3]);
+          for (size_t nu = mu + 1; nu < d; nu++) {
+            std::array<int, 4> xnu = x;
+            xnu[nu]++;
+            const size_t snu = g.getIndex(xnu[0], xnu[1], xnu[2], xnu[3]);
+            P[s * np + plane(mu, nu, d)] = U[s * d + mu] * U[smu * d + nu] *
+                                           U[snu * d + mu].dagger() * U[s * d + nu].dagger();
+          }
+        }
+      }
+    }
+  };
+
+} // namespace flat_spacetime
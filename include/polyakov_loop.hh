@@ -21,18 +21,26 @@
  * @tparam Group
  * @param U gauge configuration pointer
  * @param xi spatial components of the position
+ * @param Ubar if given, the links are replaced by (*Ubar)[x], e.g. their one-link
+ * integrals (see link_integral.hh)
  * @return double
  */
 template <class Group = su2>
 double polyakov_loop(const gaugeconfig<Group> &U,
-                     const std::array<int, spacetime_lattice::nd_max - 1> &xi) {
+                     const std::array<int, spacetime_lattice::nd_max - 1> &xi,
+                     const std::vector<typename accum_type<Group>::type> *Ubar = nullptr) {
   typedef typename accum_type<Group>::type accum;
 
   const size_t mu = 0; // Polyakov loop contains U_{\mu=0}(x) only
-  std::vector<size_t> x = {0, xi[0], xi[1], xi[2]};
+  const geometry g(U.getLx(), U.getLy(), U.getLz(), U.getLt());
+  std::vector<size_t> x = {0, size_t(xi[0]), size_t(xi[1]), size_t(xi[2])};
   accum P(1., 0.);
   for (x[0] = 0; x[0] < U.getLt(); x[0]++) {
+    if (Ubar != nullptr) {
+      P *= (*Ubar)[g.getIndex(x[0], x[1], x[2], x[3])];
+    } else {
       P *= U(x, mu);
+    }
   }
   return retrace(P); // taking the real part averages over the 2 orientations
 }
@@ -42,22 +50,23 @@ double polyakov_loop(const gaugeconfig<Group> &U,
  * (see eq. 11 of https://journals.aps.org/prd/pdf/10.1103/PhysRevD.103.094515)
  * @tparam Group
  * @param U
+ * @param Ubar if given, the one-link integrals of the temporal links
  * @return double
  */
-template <class Group = su2> double polyakov_loop_spatial_average(gaugeconfig<Group> &U) {
+template <class Group = su2>
+double polyakov_loop_spatial_average(
+  const gaugeconfig<Group> &U,
+  const std::vector<typename accum_type<Group>::type> *Ubar = nullptr) {
   double ploop = 0.;
-  typedef typename accum_type<Group>::type accum;
-  const size_t ndims = U.getndims();
-
   const size_t nd_s = spacetime_lattice::nd_max - 1;
 #pragma omp parallel for reduction(+: ploop)
   for (size_t x1 = 0; x1 < U.getLx(); x1++) {
     for (size_t x2 = 0; x2 < U.getLy(); x2++) {
       for (size_t x3 = 0; x3 < U.getLz(); x3++) {
-        std::array<int, nd_s> x = {x1, x2, x3}; // spatial position
-        ploop += polyakov_loop(U, x);
+        std::array<int, nd_s> x = {int(x1), int(x2), int(x3)}; // spatial position
+        ploop += polyakov_loop(U, x, Ubar);
       }
     }
   }
-  return ploop / U.getVolume();
+  return ploop / (U.getVolume() / U.getLt()); // spatial volume
 }
@@ -29,5 +29,6 @@ template<class T> void random_gauge_trafo(gaugeconfig<T> &U, const int seed) {
       }
     }
   }
+  U.touch();
   return;
 }
@@ -0,0 +1,128 @@
+/**
+ * @file rational_approximation.hh
+ * @brief partial fraction approximations of x^{-alpha} for the RHMC
+ *
+ * For 0 < alpha < 1 one has
+ * x^{-alpha} = sin(pi*alpha)/pi * \int_{-\infty}^{+\infty} ds e^{(1-alpha)s}/(e^s + x).
+ * The integrand is analytic in the strip |Im(s)| < pi, hence the trapezoidal rule with
+ * step h converges as exp(-2 pi^2/h) and gives the partial fraction
+ * r(x) = \sum_k a_k/(x + sigma_k), with a_k, sigma_k > 0.
+ * The two tails of the (infinite) sum are geometric series and are replaced by one
+ * pole each, matching the first two orders of their expansion in x/sigma (upper tail)
+ * and sigma/x (lower tail).
+ * The number of poles is increased until the relative error max|r(x)*x^alpha - 1| on
+ * [lambda_min, lambda_max] is below the requested tolerance.
+ *
+ * Compared to the optimal (Zolotarev/Remez) approximation this needs roughly twice as
+ * many poles, but with the multi-shift CG the cost is dominated by the smallest shift
+ * and the additional poles only add vector operations.
+ */
+
+#pragma once
+
+#include "geometry.hh"
+
+#include <cmath>
+#include <vector>
+
+namespace rational_approximation {
+
+  /**
+   * @brief r(x) = \sum_k residues[k]/(x + shifts[k])
+   */
+  struct partial_fraction {
+    std::vector<double> residues;
+    std::vector<double> shifts;
+    double error = 0.; // maximal relative error on the approximation interval
+
+    double operator()(const double &x) const {
+      double r = 0.;
+      for (size_t k = 0; k < shifts.size(); k++) {
+        r += residues[k] / (x + shifts[k]);
+      }
+      return r;
+    }
+
+    size_t size() const { return shifts.size(); }
+  };
+
+  /**
+   * @brief maximal relative error of r(x) = x^{-alpha} on a logarithmic grid
+   */
+  inline double relative_error(const partial_fraction &r,
+                               const double &alpha,
+                               const double &lmin,
+                               const double &lmax) {
+    const size_t n = 2000;
+    const double l0 = std::log(lmin), l1 = std::log(lmax);
+    double err = 0.;
+    for (size_t i = 0; i < n; i++) {
+      const double x = std::exp(l0 + (l1 - l0) * double(i) / double(n - 1));
+      err = std::max(err, std::abs(r(x) * std::pow(x, alpha) - 1.0));
+    }
+    return err;
+  }
+
+  /**
+   * @brief partial fraction approximation of x^{-alpha} on [lmin, lmax]
+   *
+   * @param alpha exponent, 0 < alpha < 1
+   * @param lmin lower bound of the interval (> 0)
+   * @param lmax upper bound of the interval
+   * @param tol maximal relative error
+   */
+  inline partial_fraction
+  inverse_power(const double &alpha, const double &lmin, const double &lmax, const double &tol) {
+    if (!(alpha > 0.0 && alpha < 1.0)) {
+      spacetime_lattice::fatal_error("The exponent must satisfy 0 < alpha < 1.", __func__);
+    }
+    if (!(lmin > 0.0 && lmax >= lmin)) {
+      spacetime_lattice::fatal_error("Invalid approximation interval.", __func__);
+    }
+    const double c = std::sin(M_PI * alpha) / M_PI;
+
+    partial_fraction r;
+    // L = -log(target error): discretization error ~ exp(-2 pi^2/h), truncation
+    // errors ~ (lmax/sigma_max)^{2+alpha} and (sigma_min/lmin)^{3-alpha}
+    for (double L = -std::log(tol); L < 200.0; L += std::log(2.0)) {
+      const double h = 2.0 * M_PI * M_PI / (L + std::log(4.0));
+      const double s_min = std::log(lmin) - L / (3.0 - alpha);
+      const double s_max = std::log(lmax) + L / (2.0 + alpha);
+      const size_t n = std::ceil((s_max - s_min) / h);
+
+      r.residues.clear();
+      r.shifts.clear();
+      for (size_t j = 0; j < n; j++) {
+        const double s = s_min + j * h;
+        r.shifts.push_back(std::exp(s));
+        r.residues.push_back(h * c * std::exp((1.0 - alpha) * s));
+      }
+
+      // upper tail s_j = s_up + j*h, j >= 0: \sum w_j/(x+sigma_j) ~ S0 - x*S1
+      const double s_up = s_min + n * h;
+      const double S0 = h * c * std::exp(-alpha * s_up) / (1.0 - std::exp(-alpha * h));
+      const double S1 =
+        h * c * std::exp(-(1.0 + alpha) * s_up) / (1.0 - std::exp(-(1.0 + alpha) * h));
+      r.shifts.push_back(S0 / S1);
+      r.residues.push_back(S0 * S0 / S1);
+
+      // lower tail s_j = s_lo - j*h, j >= 0: \sum w_j/(x+sigma_j) ~ (W0 - W1/x)/x
+      const double s_lo = s_min - h;
+      const double W0 =
+        h * c * std::exp((1.0 - alpha) * s_lo) / (1.0 - std::exp(-(1.0 - alpha) * h));
+      const double W1 =
+        h * c * std::exp((2.0 - alpha) * s_lo) / (1.0 - std::exp(-(2.0 - alpha) * h));
+      r.shifts.push_back(W1 / W0);
+      r.residues.push_back(W0);
+
+      r.error = relative_error(r, alpha, lmin, lmax);
+      if (r.error <= tol) {
+        return r;
+      }
+    }
+    spacetime_lattice::fatal_error("Rational approximation did not reach the tolerance.",
+                                   __func__);
+    return r;
+  }
+
+} // namespace rational_approximation
@@ -0,0 +1,190 @@
+// rhmc_monomial.hh
+/*
+  Rational HMC for staggered fermions: evaluation of det(D*D^{\dagger})^{alpha}
+  with the pseudo-fermion action S_F = \phi^{\dagger} * (D*D^{\dagger})^{-alpha} * \phi
+  (M. A. Clark and A. D. Kennedy, https://arxiv.org/abs/hep-lat/0608015).
+  The fractional powers are replaced by partial fractions (see
+  rational_approximation.hh) and all the poles are solved at once with the multi-shift
+  CG. For alpha=1/2 one has a single staggered field (instead of the two of
+  detDDdag_monomial), which in 4 dimensions still contains 4 tastes.
+*/
+
+#pragma once
+
+#include "adjointfield.hh"
+#include "detDDdag_monomial.hh"
+#include "gaugeconfig.hh"
+#include "hamiltonian_field.hh"
+#include "monomial.hh"
+#include "multishift_CG.hpp"
+#include "rational_approximation.hh"
+#include "su2.hh"
+#include "u1.hh"
+#include <complex>
+#include <iostream>
+#include <vector>
+
+#include "staggered.hpp" // spinor object
+
+namespace staggered {
+
+  template <typename Float, class Group>
+  class rhmc_monomial : public fermion_monomial<Float, Group> {
+    typedef std::complex<Float> Complex;
+    typedef staggered::spinor_lat<Float, Complex> spinor;
+
+    size_t n_traj = 0;
+
+  public:
+    Float m0; // bare mass (in lattice units)
+    Float alpha; // power of the determinant
+
+    // rational approximations of x^{-alpha} (action and force) and x^{-(1-alpha/2)},
+    // where x^{alpha/2} = x * x^{-(1-alpha/2)} is needed in the heatbath
+    rational_approximation::partial_fraction ra_action;
+    rational_approximation::partial_fraction ra_heatbath;
+
+    // pseudo-fermion field phi, kept constant along the MD trajectory
+    spinor phi;
+
+    /**
+     * @brief constructor
+     * The approximations are built on the interval [m0^2, m0^2 + ndims^2], which
+     * contains the whole spectrum of D*D^{\dagger}.
+     *
+     * @param _timescale timescale of the monomial
+     * @param m0_val bare mass
+     * @param alpha_val power of the determinant, 0 < alpha < 1
+     * @param ndims number of spacetime dimensions
+     * @param tolerance_ra relative error of the rational approximations
+     * @param tolerance tolerance of the multi-shift CG solver (action and force)
+     * @param seed seed for the pseudo-fermion fields
+     * @param verb verbosity of the solver
+     */
+    rhmc_monomial<Float, Group>(unsigned int _timescale,
+                                const Float &m0_val,
+                                const Float &alpha_val,
+                                const size_t &ndims,
+                                const Float &tolerance_ra,
+                                const Float &tolerance,
+                                const size_t &seed,
+                                const size_t &verb)
+      : fermion_monomial<Float, Group>(_timescale, "CG", tolerance, seed, verb) {
+      m0 = m0_val;
+      alpha = alpha_val;
+
+      const double lmin = m0 * m0, lmax = m0 * m0 + double(ndims * ndims);
+      ra_action = rational_approximation::inverse_power(alpha, lmin, lmax, tolerance_ra);
+      ra_heatbath =
+        rational_approximation::inverse_power(1.0 - alpha / 2.0, lmin, lmax, tolerance_ra);
+      std::cout << "## rhmc: alpha=" << alpha << " poles action=" << ra_action.size()
+                << " (error=" << ra_action.error << ") poles heatbath=" << ra_heatbath.size()
+                << " (error=" << ra_heatbath.error << ")\n";
+    }
+
+    /**
+     * @brief x_k = (D*D^{\dagger} + sigma_k)^{-1} * b for all the poles of r
+     * The iterations are added to `stats`.
+     */
+    std::vector<spinor> solve(const gaugeconfig<Group> &U,
+                              const rational_approximation::partial_fraction &r,
+                              const spinor &b,
+                              const Float &tol,
+                              solver_stats &stats) const {
+      const staggered::DDdag_matrix_lat<Float, Complex, Group> M(U, (*this).m0);
+      const std::vector<Float> shifts(r.shifts.begin(), r.shifts.end());
+
+      CG::MultishiftCG<Float, Complex, staggered::DDdag_matrix_lat<Float, Complex, Group>,
+                       spinor>
+        msCG;
+      msCG.solve(M, b, shifts, tol, (*this).VERBOSITY);
+      stats.add(msCG.get_iterations());
+      return msCG.get_solutions();
+    }
+
+    // phi = (D*D^{\dagger})^{alpha/2} * R, then S_F = R^{\dagger}*R
+    void heatbath(const hamiltonian_field<Float, Group> &h) override {
+      const size_t Lt = h.U->getLt(), Lx = h.U->getLx(), Ly = h.U->getLy(),
+                   Lz = h.U->getLz();
+      const nd_max_arr<size_t> dims = {Lt, Lx, Ly, Lz}; // vactor of spacetime dimensions
+
+      const spinor R = staggered::gaussian_spinor<Float, Complex>(
+        dims, 0.0, 1.0 / sqrt(2), (*this).SEED + n_traj); // e^{-x^2} has sigma=1/sqrt(2)
+
+      n_traj += 1;
+
+      const std::vector<spinor> x = (*this).solve(*h.U, ra_heatbath, R, (*this).TOLERANCE, (*this).stats_action);
+      spinor y(dims);
+      const size_t N = y.size();
+#pragma omp parallel for
+      for (size_t i = 0; i < N; i++) {
+        for (size_t k = 0; k < x.size(); k++) {
+          y[i] += ra_heatbath.residues[k] * x[k][i];
+        }
+      }
+      const staggered::DDdag_matrix_lat<Float, Complex, Group> M(*h.U, (*this).m0);
+      (*this).phi = M * y;
+
+      monomial<Float, Group>::Hold = R.norm_squared(); // R^{\dagger}*R is real
+      return;
+    }
+
+    // S_F = \sum_k a_k \phi^{\dagger} * (D*D^{\dagger} + sigma_k)^{-1} * \phi
+    void accept(const hamiltonian_field<Float, Group> &h) override {
+      const std::vector<spinor> chi = (*this).solve(*h.U, ra_action, (*this).phi,
+                                                    (*this).TOLERANCE, (*this).stats_action);
+
+      Float S = 0.0;
+      for (size_t k = 0; k < chi.size(); k++) {
+        S += ra_action.residues[k] * complex_dot_product((*this).phi, chi[k]).real();
+      }
+      monomial<Float, Group>::Hnew = S;
+      return;
+    }
+
+    /**
+     * dS_F = - \sum_k a_k \chi_k^{\dagger} * dM * \chi_k
+     * where \chi_k = (M + sigma_k)^{-1} * \phi and M = D*D^{\dagger}:
+     * each pole contributes as the force of detDDdag_monomial
+     */
+    void derivative(adjointfield<Float, Group> &deriv,
+                    const hamiltonian_field<Float, Group> &h,
+                    const Float fac = 1.) const override {
+      const std::vector<spinor> chi = (*this).solve(
+        *h.U, ra_action, (*this).phi, (*this).TOLERANCE_FORCE, (*this).stats_force);
+
+      for (size_t k = 0; k < chi.size(); k++) {
+        const spinor chi1 = staggered::apply_Ddag(*h.U, (*this).m0, chi[k]);
+        add_DDdag_force(deriv, *h.U, chi[k], chi1, Float(fac * ra_action.residues[k]));
+      }
+      return;
+    }
+  };
+
+  template <typename Float>
+  class rhmc_monomial<Float, _su2> : public fermion_monomial<Float, _su2> {
+  public:
+    rhmc_monomial(unsigned int _timescale,
+                  const Float &,
+                  const Float &,
+                  const size_t &,
+                  const Float &,
+                  const Float &tolerance,
+                  const size_t &seed,
+                  const size_t &verb)
+      : fermion_monomial<Float, _su2>(_timescale, "CG", tolerance, seed, verb) {
+      spacetime_lattice::fatal_error("SU(2) not supported yet.", __func__);
+    }
+
+    void heatbath(const hamiltonian_field<Float, _su2> &) override { return; }
+
+    void accept(const hamiltonian_field<Float, _su2> &) override { return; }
+
+    void derivative(adjointfield<Float, _su2> &,
+                    const hamiltonian_field<Float, _su2> &,
+                    const Float = 1.) const override {
+      return;
+    }
+  };
+
+} // namespace staggered
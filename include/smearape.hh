@@ -69,6 +69,7 @@ void smearlatticeape(gaugeconfig<Group> &U,
       }
     }
   }
+  U.touch();
 }
 
 /**
@@ -122,6 +123,7 @@ void APEsmearing(gaugeconfig<Group> &U, const double &alpha, const bool spatial=
       }
     }
   }
+  U.touch();
   return;
 }
 
@@ -177,17 +177,22 @@ namespace staggered {
                                           const Float &avr,
                                           const Float &sigma,
                                           const size_t &seed) {
-    std::normal_distribution<Float> dis{avr, sigma};
-    std::mt19937 gen(seed); //, gen_im(seed + 1);
-
     // Note: 'dims' is not used directly here, but is part of the correct initialization
     // of the spinor
     spinor_lat<Float, Type> psi_gauss(dims);
     const size_t n = psi_gauss.size();
 
-    for (size_t i = 0; i < n; i++) { // lattice points
-      const Type x = dis(gen);
-      psi_gauss[i] = x;
+    // counter-based streams: thread-count independent (see counter_rng.hh)
+    constexpr size_t block = 256;
+#pragma omp parallel for
+    for (size_t i0 = 0; i0 < n; i0 += block) { // lattice points
+      double r[block];
+      const size_t m = std::min(block, n - i0);
+      counter_rng::fill_normal(seed, i0, m, r);
+      for (size_t k = 0; k < m; k++) {
+        const Type x = avr + sigma * Float(r[k]);
+        psi_gauss[i0 + k] = x;
+      }
     }
     return psi_gauss;
   }
@@ -228,6 +233,7 @@ namespace staggered {
   public:
     gaugeconfig<Group> U;
     Float m;
+    mutable size_t iterations = 0; // iterations of the last call of inv()
 
     DDdag_matrix_lat() {}
     ~DDdag_matrix_lat() {}
@@ -253,6 +259,20 @@ namespace staggered {
                                 const size_t &seed) const {
       typedef spinor_lat<Float, Type> LAvector;
 
+      const LAvector phi0 =
+        staggered::gaussian_spinor<Float, Complex>(psi.get_dims(), 0.0, 10.0, seed);
+
+      return this->inv(psi, phi0, solver, tol, verb);
+    }
+
+    // same as above, starting the solver from the initial guess x0
+    spinor_lat<Float, Type> inv(const spinor_lat<Float, Type> &psi,
+                                const spinor_lat<Float, Type> &x0,
+                                const std::string &solver,
+                                const Float &tol,
+                                const size_t &verb) const {
+      typedef spinor_lat<Float, Type> LAvector;
+
       typedef DDdag_matrix_lat<Float, Type, Group> LAmatrix;
 
       typedef CG::LinearCG<Float, Type, LAmatrix, LAvector> cg;
@@ -264,14 +284,12 @@ namespace staggered {
 
       svr_type SVR((*this), psi);
 
-      const LAvector phi0 =
-        staggered::gaussian_spinor<Float, Complex>(psi.get_dims(), 0.0, 10.0, seed);
-
       if (verb > 1) {
         std::cout << "Calling the " << solver << " solver.\n";
       }
 
-      SVR.solve(phi0, tol, verb);
+      SVR.solve(x0, tol, verb);
+      (*this).iterations = SVR.get_iterations();
       return SVR.get_solution();
     }
   };
@@ -79,6 +79,10 @@ inline Complex trace(_su2 const &U) {
   return(Complex(2*a, 0.));
 }
 
+inline _su2 dagger(_su2 const &U) {
+  return(U.dagger());
+}
+
 
 template<> inline _su2 traceless_antiherm(const _su2& x) {
   return(_su2(0.5*(x.geta()-std::conj(x.geta())), x.getb()));
@@ -105,6 +109,12 @@ inline _su2 operator-(const _su2 &U1, const _su2 &U2) {
   return(res);
 }
 
+// |U1 - U2|^2 (Frobenius norm), without the cancellations of 2 - Re tr(U1*U2^{\dagger})
+inline double link_distance2(const _su2 &U1, const _su2 &U2) {
+  const _su2 D = U1 - U2;
+  return 2.0 * (std::norm(D.geta()) + std::norm(D.getb()));
+}
+
 inline _su2 operator*(const Complex &U1, const _su2 &U2) {
     _su2 res;
     res.a = U2.a * U1;
@@ -70,6 +70,10 @@ inline Complex trace(const Complex c) {
   return(c); // for U(1) the trace operator acts trivially
 }
 
+inline Complex dagger(const Complex c) {
+  return(std::conj(c));
+}
+
 template<> struct accum_type<_u1> {
   typedef Complex type;
 };
@@ -110,6 +114,9 @@ inline Complex operator-(const _u1 &U1, const _u1 &U2) {
          std::exp(U2.a*Complex(0., 1.)));
 }
 
+// |U1 - U2|^2, without the cancellations of 1 - Re(U1*U2^{\dagger})
+inline double link_distance2(const _u1 &U1, const _u1 &U2) { return std::norm(U1 - U2); }
+
 inline void operator+=(Complex & U1, const _u1 & U2) {
   U1 += std::exp(U2.geta()*Complex(0., 1.));
 }
@@ -3,15 +3,23 @@
 #include"hamiltonian_field.hh"
 #include"su2.hh"
 #include"exp_gauge.hh"
+#include<algorithm>
 #include<complex>
 
-template<typename Float, class Group> void update_gauge(hamiltonian_field<Float, Group> &h, const Float dtau) {
+// if restore is true, the links are projected back to the group in the same pass
+// (saves the separate loop of gaugeconfig::restoreSU() at the end of a trajectory)
+template<typename Float, class Group> void update_gauge(hamiltonian_field<Float, Group> &h, const Float dtau,
+                                                        const bool restore = false) {
   
-  // update the gauge field
+  // update the gauge field with the batched exponential map,
+  // each thread works on blocks of consecutive links
+  const size_t N = h.U->getSize();
+  const size_t block = 1024;
 #pragma omp parallel for
-  for(size_t i = 0; i < h.U->getSize(); i++) {
-    (*h.U)[i] = exp(dtau * (*h.momenta)[i]) * (*h.U)[i];
+  for(size_t i = 0; i < N; i += block) {
+    exp_and_multiply(std::min(block, N - i), dtau, &(*h.momenta)[i], &(*h.U)[i], restore);
   }
+  h.U->touch();
   return;
 }
 
@@ -23,5 +31,6 @@ template<typename Float, class Group> void round_and_update_gauge(hamiltonian_fi
   for(size_t i = 0; i < h.U->getSize(); i++) {
     (*h.U)[i] = exp(dtau * (*h.momenta)[i]) * (*h.U)[i].round(n);
   }
+  h.U->touch();
   return;
 }
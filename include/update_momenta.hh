@@ -11,6 +11,24 @@ template<typename Float, class Group> void update_momenta(std::list<monomial<Flo
                                                           adjointfield<Float, Group> &deriv, hamiltonian_field<Float, Group> &h, 
                                                           const double dtau) {
 
+  // count the monomials acting on this timescale
+  size_t n_active = 0;
+  monomial<Float, Group> *single = nullptr;
+  for (typename std::list<monomial<double, Group>*>::iterator it = monomial_list.begin(); it != monomial_list.end(); it++) {
+    if((*it)->getmdactive() && ((*it)->getTimescale() == 0)) {
+      n_active++;
+      single = *it;
+    }
+  }
+
+  // fused kernel: a single monomial owns the timescale, so its force is
+  // accumulated directly into the momenta, P -= dtau*F, in the same pass in which
+  // it is computed. No zeroing of deriv and no separate update loop are needed.
+  if(n_active == 1) {
+    single->derivative(*h.momenta, h, -dtau);
+    return;
+  }
+
   zeroadjointfield(deriv);
 
   // compute derivatives
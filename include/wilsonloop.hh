@@ -5,15 +5,93 @@
 #include "accum_type.hh"
 #include "gaugeconfig.hh"
 #include "geometry.hh"
+#include "parallel_reduction.hh"
 #include "su2.hh"
 
 #ifdef _USE_OMP_
 #include <omp.h>
 #endif
+#include <algorithm>
+#include <array>
 #include <fstream>
 #include <iomanip>
 #include <vector>
 
+/**
+ * @brief flat index arithmetic for the shift of a site along one axis
+ * The site index is ((x0*Lx + x1)*Ly + x2)*Lz + x3, as in gaugeconfig.
+ */
+class site_shift {
+public:
+  template <class Group>
+  explicit site_shift(const gaugeconfig<Group> &U)
+    : L{U.getLt(), U.getLx(), U.getLy(), U.getLz()},
+      stride{U.getLx() * U.getLy() * U.getLz(), U.getLy() * U.getLz(), U.getLz(), 1} {}
+
+  /**
+   * @brief index of the site x + n*\hat{mu}, where x is the site with index s
+   * n may be negative, the boundary conditions are periodic
+   */
+  size_t operator()(const size_t &s, const size_t &mu, const long &n) const {
+    const long Lmu = L[mu];
+    const size_t xmu = (s / stride[mu]) % L[mu];
+    const size_t ymu = ((long(xmu) + n) % Lmu + Lmu) % Lmu;
+    return s - xmu * stride[mu] + ymu * stride[mu];
+  }
+
+  /**
+   * @brief site with its coordinates, moved by single steps without any division
+   */
+  struct cursor {
+    size_t index;
+    std::array<size_t, 4> x;
+  };
+
+  cursor at(size_t s) const {
+    cursor c;
+    c.index = s;
+    for (size_t mu = 0; mu < 4; mu++) {
+      c.x[mu] = s / stride[mu];
+      s -= c.x[mu] * stride[mu];
+    }
+    return c;
+  }
+
+  // c -> c + \hat{mu}
+  void forward(cursor &c, const size_t &mu) const {
+    if (++c.x[mu] == L[mu]) {
+      c.x[mu] = 0;
+      c.index -= (L[mu] - 1) * stride[mu];
+    } else {
+      c.index += stride[mu];
+    }
+  }
+
+  // c -> c - \hat{mu}
+  void backward(cursor &c, const size_t &mu) const {
+    if (c.x[mu] == 0) {
+      c.x[mu] = L[mu] - 1;
+      c.index += (L[mu] - 1) * stride[mu];
+    } else {
+      c.x[mu]--;
+      c.index -= stride[mu];
+    }
+  }
+
+  /**
+   * @brief lattice spacings between x and x + n*\hat{mu}, with the boundary conditions
+   * For the one-link integrals (see link_integral.hh) two temporal lines at this
+   * distance must not be neighbours, i.e. the distance must be at least 2.
+   */
+  size_t distance(const size_t &mu, const size_t &n) const {
+    const size_t m = n % L[mu];
+    return std::min(m, L[mu] - m);
+  }
+
+private:
+  std::array<size_t, 4> L, stride;
+};
+
 /**
  * @brief Planar Wilson loop
  * Evaluation of the sum of all planar Wilson loop,
@@ -46,46 +124,48 @@
  * @param t number of steps in the \nu direction
  * @param mu 1st direction of the loop
  * @param nu 2nd direction of the loop
+ * @param Ubar if given, the links in the direction 0 are replaced by (*Ubar)[x], e.g.
+ * their one-link integrals (see link_integral.hh)
  * @return double
  */
 template <class Group = su2>
-double planar_wilsonloop_dir(const gaugeconfig<Group> &U,
-                             const size_t r,
-                             const size_t t,
-                             const size_t mu,
-                             const size_t nu) {
-  double loop = 0.;
+double planar_wilsonloop_dir(
+  const gaugeconfig<Group> &U,
+  const size_t r,
+  const size_t t,
+  const size_t mu,
+  const size_t nu,
+  const std::vector<typename accum_type<Group>::type> *Ubar = nullptr) {
   typedef typename accum_type<Group>::type accum;
+  const size_t ndims = U.getndims();
+  const site_shift shift(U);
+  auto link = [&](const size_t &y, const size_t &dir) {
+    return (dir == 0 && Ubar != nullptr) ? (*Ubar)[y] : accum(U[y * ndims + dir]);
+  };
 
-  std::vector<size_t> x = {0, 0, 0, 0};
-  for (x[0] = 0; x[0] < U.getLt(); x[0]++) {
-    for (x[1] = 0; x[1] < U.getLx(); x[1]++) {
-      for (x[2] = 0; x[2] < U.getLy(); x[2]++) {
-        for (x[3] = 0; x[3] < U.getLz(); x[3]++) {
-          std::vector<size_t> xrun = x;
-          accum L(1., 0.);
-          for (size_t _t = 0; _t < t; _t++) {
-            L *= U(xrun, nu);
-            xrun[nu] += 1;
-          }
-          for (size_t s = 0; s < r; s++) {
-            L *= U(xrun, mu);
-            xrun[mu] += 1;
-          }
-          for (size_t _t = 0; _t < t; _t++) {
-            xrun[nu] -= 1;
-            L *= U(xrun, nu).dagger();
-          }
-          for (size_t s = 0; s < r; s++) {
-            xrun[mu] -= 1;
-            L *= U(xrun, mu).dagger();
-          }
-          loop += retrace(L); // taking the real part averages over the 2 orientations
-        }
+  // parallel over the sites, the sum does not depend on the number of threads
+  return parallel_reduction::deterministic_sum<double>(
+    U.getVolume(), [&](const size_t &x) {
+      site_shift::cursor y = shift.at(x);
+      accum L(1., 0.);
+      for (size_t _t = 0; _t < t; _t++) {
+        L *= link(y.index, nu);
+        shift.forward(y, nu);
       }
-    }
-  }
-  return loop;
+      for (size_t s = 0; s < r; s++) {
+        L *= link(y.index, mu);
+        shift.forward(y, mu);
+      }
+      for (size_t _t = 0; _t < t; _t++) {
+        shift.backward(y, nu);
+        L *= dagger(link(y.index, nu));
+      }
+      for (size_t s = 0; s < r; s++) {
+        shift.backward(y, mu);
+        L *= dagger(link(y.index, mu));
+      }
+      return retrace(L); // taking the real part averages over the 2 orientations
+    });
 }
 
 /**
@@ -95,48 +175,41 @@ double planar_wilsonloop_dir(const gaugeconfig<Group> &U,
  * link is multiplied onto the loop (standard Wilson-Loop definition): loop *=
  * prod_{i=0}^{r[n]} U_{n%ndims} (x+i*e_{n%ndims}+shifts from eaarlier steps) If the path
  * is done, it is traced back in the same direction, this time using the daggered links
- * The loop is calculated for each lattice point and averaged over the entire lattice
- * parallelization trivial
+ * The loop is calculated for each lattice point and summed over the entire lattice,
+ * in parallel over the sites
  * r=(1,1,0,0)=r(1,1) is the temporal plaquette, calculated in the order t->x.
  * the order x->t can be achieved by using r=(0,1,0,0,1) and 4d or r=(0,1,0,1) in 3d.
  * */
 template <class Group = su2>
 double wilsonloop_non_planar(const gaugeconfig<Group> &U, std::vector<size_t> r) {
   // goes path outlined in r in direction t->x->y->z, could go with other orders by using
-  // longer vector r and inserting zeros parallelized with code from gauge_energy
-  double loop = 0.;
+  // longer vector r and inserting zeros
   typedef typename accum_type<Group>::type accum;
+  const size_t ndims = U.getndims();
+  const site_shift shift(U);
 
-#pragma omp parallel for reduction(+ : loop)
-  for (size_t x0 = 0; x0 < U.getLt(); x0++) {
-    for (size_t x1 = 0; x1 < U.getLx(); x1++) {
-      for (size_t x2 = 0; x2 < U.getLy(); x2++) {
-        for (size_t x3 = 0; x3 < U.getLz(); x3++) {
-          std::vector<size_t> xrun = {x0, x1, x2, x3};
-          accum L(1., 0.);
-          // needed if vector with directions contains more than 4 entries/if another
-          // order than t-x-y-z is wanted
-          size_t directionloop;
-          for (size_t direction = 0; direction < r.size(); direction++) {
-            directionloop = (direction + U.getndims()) % U.getndims();
-            for (size_t length = 0; length < r[direction]; length++) {
-              L *= U(xrun, directionloop);
-              xrun[directionloop] += 1;
-            }
-          }
-          for (size_t direction = 0; direction < r.size(); direction++) {
-            directionloop = (direction + U.getndims()) % U.getndims();
-            for (size_t length = 0; length < r[direction]; length++) {
-              xrun[directionloop] -= 1;
-              L *= U(xrun, directionloop).dagger();
-            }
-          }
-          loop += retrace(L);
+  return parallel_reduction::deterministic_sum<double>(
+    U.getVolume(), [&](const size_t &x) {
+      site_shift::cursor y = shift.at(x);
+      accum L(1., 0.);
+      // needed if vector with directions contains more than 4 entries/if another
+      // order than t-x-y-z is wanted
+      for (size_t direction = 0; direction < r.size(); direction++) {
+        const size_t mu = direction % ndims;
+        for (size_t length = 0; length < r[direction]; length++) {
+          L *= U[y.index * ndims + mu];
+          shift.forward(y, mu);
         }
       }
-    }
-  }
-  return loop;
+      for (size_t direction = 0; direction < r.size(); direction++) {
+        const size_t mu = direction % ndims;
+        for (size_t length = 0; length < r[direction]; length++) {
+          shift.backward(y, mu);
+          L *= U[y.index * ndims + mu].dagger();
+        }
+      }
+      return retrace(L);
+    });
 }
 
 /**
@@ -146,19 +219,182 @@ double wilsonloop_non_planar(const gaugeconfig<Group> &U, std::vector<size_t> r)
  * @param U gauge configuration
  * @param r spatial extent of the loops
  * @param t temporal extent of the loops
+ * @param Ubar if given, the one-link integrals of the temporal links (see
+ * link_integral.hh), used if the temporal lines are at least two lattice spacings apart
+ * (see site_shift::distance())
  * @return double
  */
 template <class Group>
-double wilsonloop(const gaugeconfig<Group> &U, const size_t r, const size_t t) {
+double wilsonloop(const gaugeconfig<Group> &U,
+                  const size_t r,
+                  const size_t t,
+                  const std::vector<typename accum_type<Group>::type> *Ubar = nullptr) {
   double loop = 0.;
   const size_t ndims = U.getndims();
-#pragma omp parallel for reduction(+ : loop)
+  const site_shift shift(U);
   for (size_t mu = 1; mu < ndims; mu++) {
-    loop += planar_wilsonloop_dir(U, r, t, mu, 0);
+    const bool averaged = (shift.distance(mu, r) >= 2);
+    loop += planar_wilsonloop_dir(U, r, t, mu, 0, averaged ? Ubar : nullptr);
   }
   return loop / U.getVolume() / double(U.getNc()) / ndims;
 }
 
+/**
+ * @brief all planar Wilson loops W(r, t), 1 <= r <= rmax, 1 <= t <= tmax
+ * The loops are built from straight Wilson lines instead of single links. With the
+ * spatial line S_r(x) = U_mu(x) U_mu(x+mu) ... U_mu(x+(r-1)mu) and the temporal line
+ * T_t(x) in the direction 0, the loop of planar_wilsonloop_dir() is
+ * W(r, t)(x) = T_t(x) S_r(x+t*0) T_t(x+r*mu)^{\dagger} S_r(x)^{\dagger}.
+ * The lines are extended by one link when r (t) increases, such that each W(r, t)
+ * costs O(V) instead of O(V*r*t), and the whole table O(V*rmax*tmax) instead of
+ * O(V*rmax^2*tmax^2). Only one field of spatial and one of temporal lines is stored.
+ * @tparam Group
+ * @param U gauge configuration
+ * @param rmax maximal spatial extent
+ * @param tmax maximal temporal extent
+ * @param Ubar if given, the one-link integrals of the temporal links (see
+ * link_integral.hh), used if the temporal lines are at least two lattice spacings apart
+ * (see site_shift::distance())
+ * @return loops[t][r], normalised as wilsonloop(U, r, t); entries with r=0 or t=0
+ * are 0
+ */
+template <class Group>
+std::vector<std::vector<double>>
+planar_wilsonloops(const gaugeconfig<Group> &U,
+                   const size_t &rmax,
+                   const size_t &tmax,
+                   const std::vector<typename accum_type<Group>::type> *Ubar = nullptr) {
+  typedef typename accum_type<Group>::type accum;
+  const size_t ndims = U.getndims();
+  const size_t V = U.getVolume();
+  const site_shift shift(U);
+  const accum one(1., 0.);
+  std::vector<std::vector<double>> loops(tmax + 1, std::vector<double>(rmax + 1, 0.));
+  std::vector<Group> S(V, U[0]);
+  std::vector<accum> T(V, one);
+
+  for (size_t mu = 1; mu < ndims; mu++) {
+    for (size_t r = 1; r <= rmax; r++) {
+      // S_r(x) = S_{r-1}(x) U_mu(x+(r-1)mu)
+#pragma omp parallel for
+      for (size_t s = 0; s < V; s++) {
+        const Group &u = U[shift(s, mu, r - 1) * ndims + mu];
+        S[s] = (r == 1) ? u : S[s] * u;
+      }
+      const bool averaged = (Ubar != nullptr && shift.distance(mu, r) >= 2);
+      for (size_t t = 1; t <= tmax; t++) {
+        // T_t(x) = T_{t-1}(x) U_0(x+(t-1)0)
+#pragma omp parallel for
+        for (size_t s = 0; s < V; s++) {
+          const size_t y = shift(s, 0, t - 1);
+          const accum u = averaged ? (*Ubar)[y] : accum(U[y * ndims]);
+          T[s] = (t == 1) ? u : T[s] * u;
+        }
+        loops[t][r] += parallel_reduction::deterministic_sum<double>(
+          V, [&](const size_t &s) {
+            return retrace(T[s] * S[shift(s, 0, t)] * dagger(T[shift(s, mu, r)]) *
+                           S[s].dagger());
+          });
+      }
+    }
+  }
+
+  for (size_t t = 1; t <= tmax; t++) {
+    for (size_t r = 1; r <= rmax; r++) {
+      loops[t][r] /= U.getVolume() * double(U.getNc()) * ndims;
+    }
+  }
+  return loops;
+}
+
+/**
+ * @brief non-planar Wilson loops W(t, a, b), t <= tmax, a <= amax, b <= bmax, in the
+ * spatial directions i < j
+ * W(t, a, b) is the sum over the lattice of the loop of wilsonloop_non_planar() with t
+ * steps in the direction 0, a steps in the direction i and b in j. With the staircase
+ * paths A_{ab}(x) (a steps in i, then b in j) and B_{ab}(x) (b steps in j, then a in i)
+ * and the temporal lines T_t(x) the loop is
+ * W(t, a, b)(x) = T_t(x) A_{ab}(x+t*0) T_t(x+a*i+b*j)^{\dagger} B_{ab}(x)^{\dagger}.
+ * The paths are cached per site and extended by one link at a time:
+ * A_{a,b+1}(x) = A_{ab}(x) U_j(x+a*i+b*j) and B_{ab}(x) = S^j_b(x) S^i_a(x+b*j) from the
+ * straight lines S. Each W(t, a, b) then costs O(V) instead of O(V*(t+a+b)).
+ * @tparam Group
+ * @param U gauge configuration
+ * @param i first spatial direction
+ * @param j second spatial direction, i < j
+ * @param tmax maximal temporal extent
+ * @param amax maximal extent in the direction i
+ * @param bmax maximal extent in the direction j
+ * @param Ubar if given, the one-link integrals of the temporal links (see
+ * link_integral.hh), used if the temporal lines are not neighbours, i.e. at least two
+ * lattice spacings apart (see site_shift::distance())
+ * @return loops[t][a][b], summed (not averaged) over the sites as
+ * wilsonloop_non_planar()
+ */
+template <class Group>
+std::vector<std::vector<std::vector<double>>>
+nonplanar_wilsonloops(const gaugeconfig<Group> &U,
+                      const size_t &i,
+                      const size_t &j,
+                      const size_t &tmax,
+                      const size_t &amax,
+                      const size_t &bmax,
+                      const std::vector<typename accum_type<Group>::type> *Ubar = nullptr) {
+  typedef typename accum_type<Group>::type accum;
+  const size_t ndims = U.getndims();
+  const size_t V = U.getVolume();
+  const site_shift shift(U);
+  const Group one(accum(1., 0.));
+  std::vector<std::vector<std::vector<double>>> loops(
+    tmax + 1, std::vector<std::vector<double>>(amax + 1, std::vector<double>(bmax + 1)));
+  std::vector<Group> Si(V, one), Sj(V, one), A(V, one), B(V, one);
+  std::vector<accum> T(V, accum(1., 0.));
+  std::vector<size_t> corner(V); // index of x+a*i+b*j
+
+  for (size_t a = 0; a <= amax; a++) {
+    if (a > 0) {
+#pragma omp parallel for
+      for (size_t s = 0; s < V; s++) {
+        Si[s] = Si[s] * U[shift(s, i, a - 1) * ndims + i];
+      }
+    }
+    for (size_t b = 0; b <= bmax; b++) {
+#pragma omp parallel for
+      for (size_t s = 0; s < V; s++) {
+        if (b == 0) {
+          corner[s] = shift(s, i, a);
+          A[s] = Si[s];
+          Sj[s] = one;
+        } else {
+          A[s] = A[s] * U[corner[s] * ndims + j];
+          corner[s] = shift(corner[s], j, 1);
+          Sj[s] = Sj[s] * U[shift(s, j, b - 1) * ndims + j];
+        }
+        B[s] = Sj[s] * Si[shift(s, j, b)];
+      }
+      const bool averaged =
+        (Ubar != nullptr && shift.distance(i, a) + shift.distance(j, b) >= 2);
+      for (size_t t = 0; t <= tmax; t++) {
+#pragma omp parallel for
+        for (size_t s = 0; s < V; s++) {
+          if (t == 0) {
+            T[s] = accum(1., 0.);
+          } else {
+            const size_t y = shift(s, 0, t - 1);
+            T[s] = T[s] * (averaged ? (*Ubar)[y] : accum(U[y * ndims]));
+          }
+        }
+        loops[t][a][b] = parallel_reduction::deterministic_sum<double>(
+          V, [&](const size_t &s) {
+            return retrace(T[s] * A[shift(s, 0, t)] * dagger(T[corner[s]]) *
+                           B[s].dagger());
+          });
+      }
+    }
+  }
+  return loops;
+}
+
 /**
  * @brief saving all planar loop of the lattice grid
  * Computing and printing averages of all planar loops
@@ -166,9 +402,13 @@ double wilsonloop(const gaugeconfig<Group> &U, const size_t r, const size_t t) {
  * @tparam Group
  * @param U gauge config
  * @param path path of the output file
+ * @param Ubar if given, the one-link integrals of the temporal links (see
+ * planar_wilsonloops())
  */
 template <class Group>
-void compute_all_loops(const gaugeconfig<Group> &U, std::string const &path) {
+void compute_all_loops(const gaugeconfig<Group> &U,
+                       std::string const &path,
+                       const std::vector<typename accum_type<Group>::type> *Ubar = nullptr) {
   // checking the spatial symmetry of the lattice
   const size_t Lt = U.getLt(), Lx = U.getLx();
 
@@ -182,11 +422,11 @@ void compute_all_loops(const gaugeconfig<Group> &U, std::string const &path) {
   oss << "\n";
 
   // printing the data in the format t L(r=1) L(r=2) ... L(r=Lx-1)
+  const std::vector<std::vector<double>> loops = planar_wilsonloops(U, Lx - 1, Lt - 1, Ubar);
   for (size_t t = 1; t < Lt; t++) {
     oss << t;
     for (size_t r = 1; r < Lx; r++) {
-      double loop = wilsonloop(U, r, t);
-      oss << " " << std::scientific << std::setprecision(15) << loop;
+      oss << " " << std::scientific << std::setprecision(15) << loops[t][r];
     }
     oss << std::endl;
   }
@@ -201,11 +441,11 @@ template <class Group>
 void compute_spacial_loops(gaugeconfig<Group> &U, std::string const &path) {
   std::ofstream os(path, std::ios::out);
   size_t r[2] = {2, 8};
+  const std::vector<std::vector<double>> loops = planar_wilsonloops(U, r[1], U.getLt() - 1);
   for (size_t t = 1; t < U.getLt(); t++) {
     os << t;
     for (size_t i = 0; i < 2; i++) {
-      double loop = wilsonloop(U, r[i], t);
-      os << " " << std::scientific << std::setw(15) << loop;
+      os << " " << std::scientific << std::setw(15) << loops[t][r[i]];
     }
     os << std::endl;
   }
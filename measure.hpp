@@ -13,6 +13,9 @@
 
 #include "detDDdag_monomial.hh"
 
+#include <future>
+#include <vector>
+
 template <class Group> class measure_algo : public base_program<Group, gp::measure> {
 public:
   measure_algo() {}
@@ -38,10 +41,78 @@ public:
                             : (*this).omeas.icounter;
     const size_t nmax =
       (*this).omeas.n_meas * (*this).omeas.nstep + (*this).omeas.icounter;
+    if ((*this).omeas.gradient_flow.measure_it && (*this).omeas.gradient_flow.batch > 1) {
+      this->run_batched(istart, nmax);
+      return;
+    }
     for (size_t i = istart; i < nmax; i += (*this).omeas.nstep) {
       this->do_omeas_i(i);
     }
 
     return;
   }
+
+private:
+  // configurations of one batch with their indices
+  struct conf_batch {
+    std::vector<size_t> idx;
+    std::vector<gaugeconfig<Group>> U;
+  };
+
+  // load the configurations i = first, first + nstep, ... below last, skipping the ones
+  // that cannot be read or are not measured (see do_omeas_i()). Runs concurrently to
+  // the measurements, hence it does not touch U.
+  conf_batch load_batch(const size_t &first, const size_t &last) const {
+    conf_batch b;
+    const size_t nstep = (*this).omeas.nstep;
+    const global_parameters::physics &pp = (*this).pparams;
+    for (size_t i = first; i < last; i += nstep) {
+      if (!(i > (*this).omeas.icounter && (i % nstep) == 0)) {
+        continue;
+      }
+      gaugeconfig<Group> V(pp.Lx, pp.Ly, pp.Lz, pp.Lt, pp.ndims, pp.beta);
+      if (V.load((*this).conf_path_basename + "." + std::to_string(i)) == 0) {
+        b.idx.push_back(i);
+        b.U.push_back(V);
+      }
+    }
+    return b;
+  }
+
+  /**
+   * @brief offline measurements with the gradient flow of `batch` configurations at a
+   * time (see omeasurements::meas_gradient_flow_batch())
+   * The next batch is read from disk while the current one is flowed. The other
+   * measurements are done afterwards, one configuration at a time.
+   */
+  void run_batched(const size_t &istart, const size_t &nmax) {
+    const size_t nstep = (*this).omeas.nstep;
+    const size_t stride = (*this).omeas.gradient_flow.batch * nstep;
+
+    std::future<conf_batch> next =
+      std::async(std::launch::async, [this, istart, stride, nmax]() {
+        return (*this).load_batch(istart, std::min(istart + stride, nmax));
+      });
+    for (size_t first = istart; first < nmax; first += stride) {
+      const conf_batch b = next.get();
+      if (first + stride < nmax) {
+        next = std::async(std::launch::async, [this, first, stride, nmax]() {
+          return (*this).load_batch(first + stride, std::min(first + 2 * stride, nmax));
+        });
+      }
+
+      if ((*this).omeas.verbosity > 0) {
+        std::cout << "## offline measuring: Gradient flow of " << b.idx.size()
+                  << " configurations\n";
+      }
+      omeasurements::meas_gradient_flow_batch<Group>(b.U, b.idx, (*this).pparams,
+                                                      (*this).omeas);
+
+      for (size_t k = 0; k < b.idx.size(); k++) {
+        (*this).U = b.U[k];
+        this->do_omeas_U(b.idx[k], false);
+      }
+    }
+    return;
+  }
 };
@@ -230,10 +230,109 @@ namespace input_file_parsing {
     in.read_verb<double>(mgfparams.tmax, {"tmax"});
     in.read_opt_verb<double>(mgfparams.tstart, {"tstart"});
     in.read_verb<bool>(mgfparams.save_conf, {"save_conf"});
+    if (nd["measure_times"]) {
+      in.read_sequence_verb<double>(mgfparams.measure_times, {"measure_times"});
+    }
+    in.read_opt_verb<size_t>(mgfparams.batch, {"batch"});
+    if (mgfparams.batch == 0) {
+      spacetime_lattice::fatal_error("gradient_flow: batch must be > 0", __func__);
+    }
+    if (nd["adaptive"]) {
+      mgfparams.adaptive = true;
+      in.read_opt_verb<double>(mgfparams.tolerance, {"adaptive", "tolerance"});
+      if (mgfparams.tolerance <= 0.0) {
+        spacetime_lattice::fatal_error("gradient_flow: adaptive: tolerance must be > 0",
+                                       __func__);
+      }
+    }
+    if (nd["scale_setting"]) {
+      mgfparams.scale_setting = true;
+      in.read_opt_verb<double>(mgfparams.t0_ref, {"scale_setting", "t0_ref"});
+      in.read_opt_verb<double>(mgfparams.w0_ref, {"scale_setting", "w0_ref"});
+      in.read_opt_verb<double>(mgfparams.scale_margin, {"scale_setting", "margin"});
+      if (mgfparams.scale_margin < 0.0) {
+        spacetime_lattice::fatal_error("gradient_flow: scale_setting: margin must be >= 0",
+                                       __func__);
+      }
+      if (mgfparams.adaptive) {
+        spacetime_lattice::fatal_error(
+          "gradient_flow: scale_setting works with the fixed step size only", __func__);
+      }
+    }
+
+    in.set_InnerTree(state0); // reset to previous state
+  }
+
+  /**
+   * @brief parsing the `cooling` block of the measurements
+   *
+   * @param in inspection node (full tree)
+   * @param inner_tree path to the given branch of the tree
+   * @param mcparams reference to the cooling parameters
+   */
+  void parse_cooling_measure(Yp::inspect_node &in,
+                             const std::vector<std::string> &inner_tree,
+                             gp::measure_cooling &mcparams) {
+    const std::vector<std::string> state0 = in.get_InnerTree();
+    in.dig_deeper(inner_tree); // entering the cooling node
+    YAML::Node nd = in.get_outer_node();
+
+    mcparams.measure_it = true;
+    in.read_verb<size_t>(mcparams.n_sweeps, {"n_sweeps"});
+    in.read_opt_verb<double>(mcparams.alpha, {"alpha"});
+    if (!(mcparams.alpha > 0.0 && mcparams.alpha < 2.0)) {
+      spacetime_lattice::fatal_error("cooling: alpha must satisfy 0 < alpha < 2", __func__);
+    }
+    if (nd["measure_sweeps"]) {
+      in.read_sequence_verb<size_t>(mcparams.measure_sweeps, {"measure_sweeps"});
+    }
+
+    in.set_InnerTree(state0); // reset to previous state
+  }
+
+  /**
+   * @brief parsing the `multilevel` block of the measurements
+   *
+   * @param in inspection node (full tree)
+   * @param inner_tree path to the given branch of the tree
+   * @param mlparams reference to the multilevel parameters
+   */
+  void parse_multilevel_measure(Yp::inspect_node &in,
+                                const std::vector<std::string> &inner_tree,
+                                gp::measure_multilevel &mlparams) {
+    const std::vector<std::string> state0 = in.get_InnerTree();
+    in.dig_deeper(inner_tree); // entering the multilevel node
+
+    mlparams.measure_it = true;
+    in.read_opt_verb<size_t>(mlparams.thickness, {"thickness"});
+    in.read_opt_verb<size_t>(mlparams.rmax, {"rmax"});
+    in.read_opt_verb<size_t>(mlparams.n_sub, {"n_sub"});
+    in.read_opt_verb<size_t>(mlparams.n_sweeps, {"n_sweeps"});
+    in.read_opt_verb<size_t>(mlparams.n_hit, {"n_hit"});
+    in.read_opt_verb<double>(mlparams.delta, {"delta"});
+    if (mlparams.thickness == 0 || mlparams.n_sub == 0) {
+      spacetime_lattice::fatal_error("multilevel: thickness and n_sub must be positive",
+                                     __func__);
+    }
 
     in.set_InnerTree(state0); // reset to previous state
   }
 
+  /**
+   * @brief the one-link integrals (see link_integral.hh) average the links with the
+   * weight of the pure gauge Wilson action, with fermions they would bias the loops
+   *
+   * @param mparams measurement parameters
+   * @param fermions true if the action contains fermion monomials
+   */
+  void check_link_integral(const gp::measure &mparams, const bool &fermions) {
+    if (mparams.link_integral && fermions) {
+      spacetime_lattice::fatal_error(
+        "link_integral is valid only for the pure gauge action, not with fermions",
+        __func__);
+    }
+  }
+
   /**
    * @brief parsing the online measurement block of the YAML input file
    *
@@ -274,6 +373,8 @@ namespace input_file_parsing {
     }
 
     in.read_opt_verb<bool>(mparams.Wloop, {"Wloop"});
+    in.read_opt_verb<bool>(mparams.Ploop, {"Ploop"});
+    in.read_opt_verb<bool>(mparams.link_integral, {"link_integral"});
 
     // optional parameters for potentials
     if (nd["potential"]) {
@@ -289,6 +390,10 @@ namespace input_file_parsing {
       in.read_opt_verb<double>(mparams.alpha, {"potential", "alpha"});
       in.read_opt_verb<double>(mparams.sizeWloops, {"potential", "sizeWloops"});
     }
+    if (mparams.link_integral && mparams.n_apesmear > 0 && !mparams.smear_spatial_only) {
+      spacetime_lattice::fatal_error(
+        "link_integral needs unsmeared temporal links, use smear_spatial_only", __func__);
+    }
     if (nd["glueball"]) {
       parse_glueball_measure(in, {"glueball"}, mparams.glueball);
     }
@@ -296,6 +401,12 @@ namespace input_file_parsing {
     if (nd["gradient_flow"]) {
       parse_gradient_flow_measure(in, {"gradient_flow"}, mparams.gradient_flow);
     }
+    if (nd["cooling"]) {
+      parse_cooling_measure(in, {"cooling"}, mparams.cooling);
+    }
+    if (nd["multilevel"]) {
+      parse_multilevel_measure(in, {"multilevel"}, mparams.multilevel);
+    }
 
     in.set_InnerTree(state0); // reset to previous state
   }
@@ -372,6 +483,23 @@ namespace input_file_parsing {
     in.read_opt_verb<size_t>(hparams.beta_str_width, {"beta_str_width"});
     validate_beta_str_width(hparams.beta_str_width);
 
+    in.read_opt_verb<double>(hparams.tolerance_action, {"tolerance_action"});
+    in.read_opt_verb<double>(hparams.tolerance_force, {"tolerance_force"});
+    in.read_opt_verb<bool>(hparams.scale_tolerance_force, {"scale_tolerance_force"});
+
+    if (nd["lyapunov"]) {
+      hparams.lyapunov = true;
+      in.read_opt_verb<size_t>(hparams.lyapunov_nstep, {"lyapunov", "nstep"});
+      in.read_opt_verb<size_t>(hparams.lyapunov_copies, {"lyapunov", "n_copies"});
+      in.read_opt_verb<double>(hparams.lyapunov_delta, {"lyapunov", "delta"});
+      in.read_opt_verb<size_t>(hparams.lyapunov_steps, {"lyapunov", "n_steps"});
+      if (hparams.lyapunov_nstep == 0 || hparams.lyapunov_copies == 0 ||
+          hparams.lyapunov_steps == 0 || !(hparams.lyapunov_delta > 0.)) {
+        spacetime_lattice::fatal_error(
+          "Lyapunov: nstep, n_copies, n_steps and delta must be positive.", __func__);
+      }
+    }
+
     in.set_InnerTree(state0); // reset to previous state
     return;
   }
@@ -389,6 +517,24 @@ namespace input_file_parsing {
     in.read_opt_verb<size_t>(hparams.exponent, {"exponent"});
     in.read_opt_verb<std::string>(hparams.integrator, {"name"});
 
+    if (nd["autotune"]) {
+      hparams.autotune = true;
+      in.read_opt_verb<size_t>(hparams.n_therm_tune, {"autotune", "n_therm"});
+      in.read_opt_verb<size_t>(hparams.n_tune, {"autotune", "n_tune"});
+      in.read_opt_verb<double>(hparams.target_acceptance,
+                               {"autotune", "target_acceptance"});
+      if (nd["autotune"]["integrators"]) {
+        in.read_sequence_verb<std::string>(hparams.tune_integrators,
+                                           {"autotune", "integrators"});
+      }
+    }
+
+    if (nd["kramers"]) {
+      hparams.kramers = true;
+      in.read_opt_verb<double>(hparams.kramers_gamma, {"kramers", "gamma"});
+      in.read_opt_verb<size_t>(hparams.kramers_kmax, {"kramers", "k_max"});
+    }
+
     in.set_InnerTree(state0); // reset to previous state
   }
 
@@ -444,11 +590,91 @@ namespace input_file_parsing {
   }
 
   namespace hmc {
+    /**
+     * @brief parse the Hasenbusch splitting of the staggered determinant (optional)
+     *
+     * @param in
+     * @param pparams physics parameters (m0 has to be already known)
+     * @param hparams hmc parameters
+     */
+    void parse_hasenbusch(Yp::inspect_node &in,
+                          const gp::physics &pparams,
+                          gp::hmc &hparams) {
+      YAML::Node nd = in.get_outer_node();
+      if (!pparams.include_staggered_fermions ||
+          !nd["monomials"]["staggered_det_DDdag"]["hasenbusch"]) {
+        return;
+      }
+      const std::vector<std::string> tree = {"monomials", "staggered_det_DDdag",
+                                             "hasenbusch"};
+
+      std::vector<std::string> t_masses = tree, t_tols = tree;
+      t_masses.push_back("masses");
+      t_tols.push_back("tolerances");
+      in.read_sequence_verb<double>(hparams.hasenbusch_masses, t_masses);
+
+      const std::vector<double> &m = hparams.hasenbusch_masses;
+      for (size_t k = 0; k < m.size(); k++) {
+        const double m_next = (k + 1 < m.size()) ? m[k + 1] : pparams.m0;
+        if (!(m[k] > m_next)) {
+          spacetime_lattice::fatal_error(
+            "Hasenbusch masses must be decreasing and larger than the fermion mass.",
+            __func__);
+        }
+      }
+
+      // by default all the monomials use the tolerance of the determinant
+      hparams.hasenbusch_tolerances.assign(m.size() + 1, hparams.tolerance_cg);
+      if (nd["monomials"]["staggered_det_DDdag"]["hasenbusch"]["tolerances"]) {
+        in.read_sequence_verb<double>(hparams.hasenbusch_tolerances, t_tols);
+        if (hparams.hasenbusch_tolerances.size() != m.size() + 1) {
+          spacetime_lattice::fatal_error(
+            "Hasenbusch tolerances: one value per monomial (number of masses + 1).",
+            __func__);
+        }
+      }
+      return;
+    }
+
+    /**
+     * @brief parse the rational HMC monomial (optional)
+     *
+     * @param in
+     * @param pparams physics parameters
+     * @param hparams hmc parameters
+     */
+    void parse_rhmc(Yp::inspect_node &in, gp::physics &pparams, gp::hmc &hparams) {
+      YAML::Node nd = in.get_outer_node();
+      if (!(nd["monomials"]["staggered_rhmc"] && nd["operators"]["staggered"])) {
+        return;
+      }
+      hparams.rhmc = true;
+      if (!pparams.include_staggered_fermions) { // otherwise already read
+        in.read_verb<double>(pparams.m0, {"operators", "staggered", "mass"});
+      }
+      in.read_verb<double>(hparams.rhmc_alpha, {"monomials", "staggered_rhmc", "alpha"});
+      in.read_opt_verb<double>(hparams.rhmc_tolerance_ra,
+                               {"monomials", "staggered_rhmc", "tolerance_ra"});
+      in.read_opt_verb<double>(hparams.rhmc_tolerance_cg,
+                               {"monomials", "staggered_rhmc", "tolerance_cg"});
+      in.read_opt_verb<size_t>(hparams.rhmc_solver_verbosity,
+                               {"monomials", "staggered_rhmc", "solver_verbosity"});
+      in.read_opt_verb<size_t>(hparams.rhmc_seed_pf,
+                               {"monomials", "staggered_rhmc", "seed_pf"});
+      return;
+    }
+
     void parse_input_file(const YAML::Node &nd, gp::physics &pparams, gp::hmc &hparams) {
       Yp::inspect_node in(nd);
 
       parse_geometry(in, pparams);
       parse_action<gp::hmc>(in, {}, pparams, hparams);
+      if (pparams.include_staggered_fermions) {
+        in.read_opt_verb<size_t>(hparams.n_chrono,
+                                 {"monomials", "staggered_det_DDdag", "n_chrono"});
+      }
+      parse_hasenbusch(in, pparams, hparams);
+      parse_rhmc(in, pparams, hparams);
 
       parse_hmc(in, {"hmc"}, hparams); // hmc-u1 parameters
       parse_integrator(in, {"integrator"}, hparams); // integrator parameters
@@ -458,6 +684,8 @@ namespace input_file_parsing {
         hparams.do_omeas = true;
         hparams.omeas.conf_dir = hparams.conf_dir;
         parse_omeas(in, {"omeas"}, hparams.omeas);
+        check_link_integral(hparams.omeas,
+                            pparams.include_staggered_fermions || hparams.rhmc);
       }
 
       in.finalize();
@@ -483,6 +711,9 @@ namespace input_file_parsing {
 
       if (nd["omeas"]) {
         parse_omeas(in, {"omeas"}, mparams);
+        // the configurations may come from a run with dynamical fermions
+        check_link_integral(mparams, nd["monomials"]["staggered_det_DDdag"] ||
+                                       nd["monomials"]["staggered_rhmc"]);
       }
 
       in.finalize();
@@ -506,6 +737,7 @@ namespace input_file_parsing {
         mcparams.do_omeas = true;
         mcparams.omeas.conf_dir = mcparams.conf_dir;
         parse_omeas(in, {"omeas"}, mcparams.omeas);
+        check_link_integral(mcparams.omeas, pparams.include_staggered_fermions);
       }
 
       in.finalize();
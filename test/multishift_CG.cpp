@@ -0,0 +1,54 @@
+// multishift_CG.cpp
+
+#include <complex>
+
+#include "CG.hpp"
+#include "LA.hpp"
+#include "multishift_CG.hpp"
+
+typedef std::complex<double> Type;
+
+const Type i(0.0, 1.0);
+
+typedef LA::LAmatrix<Type> LAmatrix;
+typedef LA::LAvector<double, Type> LAvector;
+
+int main(int argc, char const *argv[]) {
+
+  std::cout << "running multishift_CG.cpp\n";
+
+  // hermitian and positive definite matrix
+  LAmatrix A(0, 0);
+  A.add_row((std::vector<Type>){4.0, 1.0 + i, 0.5});
+  A.add_row((std::vector<Type>){1.0 - i, 3.0, -1.0 * i});
+  A.add_row((std::vector<Type>){0.5, 1.0 * i, 2.0});
+
+  std::cout << "A=" << '\n';
+  CG::print_LAmatrix<Type, LAmatrix, LAvector>(A, ",");
+  const LAvector b = (std::vector<Type>){1.0, -2.0 + i, 3.0};
+  const std::vector<double> shifts = {0.0, 0.1, 1.0, 10.0};
+
+  CG::MultishiftCG<double, Type, LAmatrix, LAvector> MSCG;
+  MSCG.solve(A, b, shifts, 1e-14, 1);
+  const std::vector<LAvector> x = MSCG.get_solutions();
+
+  // comparison with the standard CG for each shift separately
+  for (size_t k = 0; k < shifts.size(); k++) {
+    LAmatrix As = A;
+    for (size_t j = 0; j < As.rows(); j++) {
+      As[j][j] += shifts[k];
+    }
+    const LAvector x0 = (std::vector<Type>){0.0, 0.0, 0.0};
+    CG::LinearCG<double, Type, LAmatrix, LAvector> LCG(As, b);
+    LCG.solve(x0, 1e-14, 0);
+    const LAvector y = LCG.get_solution();
+
+    std::cout << "shift = " << shifts[k] << "\n";
+    std::cout << "multi-shift CG: x = ";
+    CG::print_LAvector<Type, LAvector>(x[k], ",");
+    std::cout << "CG:             x = ";
+    CG::print_LAvector<Type, LAvector>(y, ",");
+  }
+
+  return 0;
+}